@@ -0,0 +1,339 @@
+// Microbenchmarks of the search server on a synthetic corpus; the results are printed as JSON.
+// Build from this directory with all the sources of the server except main.cpp and test_example_functions.cpp, e.g.
+//   g++ -std=c++17 -O2 -DSEARCH_SERVER_DISABLE_PROFILING -DSEARCH_SERVER_DISABLE_TRACING -pthread benchmark.cpp corpus_generator.cpp <sources> -ltbb
+// Every benchmark runs --warmup times unmeasured and then --repetitions times; the median and the minimum time are reported.
+// Options: --documents=N --queries=N --seed=N --zipf=X --filter=SUBSTRING --warmup=N --repetitions=N
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <execution>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../process_queries.h"
+#include "../remove_duplicates.h"
+#include "../request_queue.h"
+#include "../search_server.h"
+#include "corpus_generator.h"
+
+
+namespace {
+
+std::atomic<uint64_t> allocation_count{ 0 };
+
+}  // namespace
+
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+
+void operator delete(void* pointer) noexcept {
+    // Through a volatile pointer, so that the compiler doesn't pair it with the replaced operator new
+    void (*volatile release)(void*) = std::free;
+    release(pointer);
+}
+
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+
+namespace {
+
+struct BenchmarkOptions {
+    CorpusOptions corpus;
+    QueryMixOptions queries;
+    std::string filter;
+    size_t warmup_count = 1;
+    size_t repetition_count = 5;
+};
+
+
+class BenchmarkRunner {
+public:
+    BenchmarkRunner(std::ostream& output, std::string filter, size_t warmup_count, size_t repetition_count)
+        : output_(output)
+        , filter_(std::move(filter))
+        , warmup_count_(warmup_count)
+        , repetition_count_(std::max<size_t>(1, repetition_count))
+    {
+    }
+
+
+    bool IsEnabled(std::string_view name) const {
+        return name.find(filter_) != std::string_view::npos;
+    }
+
+
+    // Runs operation(i) for every i from 0 to operation_count - 1 in every warm-up run and repetition.
+    // The setup runs before each of them and is not measured; the benchmarks that change their state reset it there.
+    void Run(std::string_view name, size_t operation_count, const std::function<void(size_t)>& operation,
+        const std::function<void()>& setup = {}) {
+        using namespace std::chrono;
+        if (!IsEnabled(name) || operation_count == 0) {
+            return;
+        }
+        // The allocations are counted for the last run only
+        uint64_t allocations = 0;
+        const auto run_once = [&]() {
+            if (setup) {
+                setup();
+            }
+            const uint64_t allocations_before = allocation_count.load(std::memory_order_relaxed);
+            const auto start_time = steady_clock::now();
+            for (size_t i = 0; i < operation_count; ++i) {
+                operation(i);
+            }
+            const auto elapsed = steady_clock::now() - start_time;
+            allocations = allocation_count.load(std::memory_order_relaxed) - allocations_before;
+            return static_cast<double>(duration_cast<nanoseconds>(elapsed).count()) / operation_count;
+        };
+        for (size_t run = 0; run < warmup_count_; ++run) {
+            run_once();
+        }
+
+        std::vector<double> ns_per_op;
+        ns_per_op.reserve(repetition_count_);
+        for (size_t repetition = 0; repetition < repetition_count_; ++repetition) {
+            ns_per_op.push_back(run_once());
+        }
+        std::sort(ns_per_op.begin(), ns_per_op.end());
+        const size_t middle = ns_per_op.size() / 2;
+        const double median_ns = ns_per_op.size() % 2 == 1 ? ns_per_op[middle] : (ns_per_op[middle - 1] + ns_per_op[middle]) / 2.0;
+
+        output_ << (is_first_ ? "\n" : ",\n");
+        output_ << "    {\"name\": \"" << name << "\", \"iterations\": " << operation_count
+            << ", \"repetitions\": " << repetition_count_
+            << ", \"ns_per_op\": " << median_ns
+            << ", \"min_ns_per_op\": " << ns_per_op.front()
+            << ", \"ops_per_second\": " << (median_ns > 0.0 ? 1e9 / median_ns : 0.0)
+            << ", \"allocations_per_op\": " << static_cast<double>(allocations) / operation_count << "}";
+        is_first_ = false;
+    }
+
+private:
+    std::ostream& output_;
+    const std::string filter_;
+    const size_t warmup_count_;
+    const size_t repetition_count_;
+    bool is_first_ = true;
+};
+
+
+BenchmarkOptions ParseOptions(int argc, char* argv[]) {
+    using namespace std::string_literals;
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        const size_t separator = argument.find('=');
+        const std::string_view name = argument.substr(0, separator);
+        const std::string value(separator == std::string_view::npos ? ""s : std::string(argument.substr(separator + 1)));
+        if (name == "--documents") {
+            options.corpus.document_count = std::stoul(value);
+        } else if (name == "--queries") {
+            options.queries.query_count = std::stoul(value);
+        } else if (name == "--seed") {
+            options.corpus.seed = std::stoull(value);
+        } else if (name == "--zipf") {
+            options.corpus.zipf_exponent = std::stod(value);
+        } else if (name == "--filter") {
+            options.filter = value;
+        } else if (name == "--warmup") {
+            options.warmup_count = std::stoul(value);
+        } else if (name == "--repetitions") {
+            options.repetition_count = std::stoul(value);
+        } else {
+            throw std::invalid_argument("Unknown option "s + std::string(argument));
+        }
+    }
+    return options;
+}
+
+
+void FillSearchServer(SearchServer& search_server, const std::vector<GeneratedDocument>& documents) {
+    for (const GeneratedDocument& document : documents) {
+        search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+}
+
+
+// Queries of two required words, either of neighbouring document frequencies among the most frequent
+// words, so that no posting list is short, or of a frequent word and a word of the median frequency
+std::vector<std::string> MakeRequiredQueries(const std::vector<GeneratedDocument>& documents, const std::string& stop_words,
+    size_t query_count, bool are_similar) {
+    std::set<std::string> stop_word_set;
+    std::istringstream stop_word_input(stop_words);
+    for (std::string word; stop_word_input >> word;) {
+        stop_word_set.insert(word);
+    }
+    std::map<std::string, size_t> word_to_document_count;
+    for (const GeneratedDocument& document : documents) {
+        std::set<std::string> document_words;
+        std::istringstream input(document.text);
+        for (std::string word; input >> word;) {
+            if (!stop_word_set.count(word)) {
+                document_words.insert(word);
+            }
+        }
+        for (const std::string& word : document_words) {
+            ++word_to_document_count[word];
+        }
+    }
+    std::vector<std::pair<size_t, std::string>> words;
+    for (const auto& [word, document_count] : word_to_document_count) {
+        words.emplace_back(document_count, word);
+    }
+    std::sort(words.rbegin(), words.rend());
+
+    std::vector<std::string> queries;
+    const size_t head_size = std::min<size_t>(100, words.size() / 2);
+    for (size_t i = 0; i < query_count && head_size > 0; ++i) {
+        const size_t index = i % head_size;
+        const std::string& other_word = are_similar ? words[index + 1].second : words[words.size() / 2 + index].second;
+        queries.push_back("+" + words[index].second + " +" + other_word);
+    }
+    return queries;
+}
+
+
+void RunBenchmarks(const BenchmarkOptions& options, std::ostream& output) {
+    CorpusGenerator generator(options.corpus);
+    const std::vector<GeneratedDocument> documents = generator.GenerateDocuments();
+    const std::vector<std::string> queries = generator.GenerateQueries(options.queries);
+    const std::string stop_words = generator.GetStopWords();
+    const auto is_even_rating = [](int, DocumentStatus, int rating) {
+        return rating % 2 == 0;
+    };
+
+    output << "{\n  \"corpus\": {\"seed\": " << options.corpus.seed << ", \"documents\": " << documents.size()
+        << ", \"vocabulary\": " << options.corpus.vocabulary_size << ", \"zipf_exponent\": " << options.corpus.zipf_exponent
+        << ", \"queries\": " << queries.size() << "},\n  \"benchmarks\": [";
+    BenchmarkRunner runner(output, options.filter, options.warmup_count, options.repetition_count);
+
+    // Every run of the benchmarks that change a search server starts from a new one
+    std::unique_ptr<SearchServer> changed_search_server;
+    runner.Run("AddDocument", documents.size(), [&](size_t i) {
+        const GeneratedDocument& document = documents[i];
+        changed_search_server->AddDocument(document.id, document.text, document.status, document.ratings);
+        }, [&]() {
+            changed_search_server = std::make_unique<SearchServer>(stop_words);
+        });
+    runner.Run("AddDocument/analyzer", documents.size(), [&](size_t i) {
+        const GeneratedDocument& document = documents[i];
+        changed_search_server->AddDocument(document.id, document.text, document.status, document.ratings);
+        }, [&]() {
+            changed_search_server = std::make_unique<SearchServer>(stop_words);
+            changed_search_server->EnableTextAnalyzer();
+        });
+
+    SearchServer search_server(stop_words);
+    FillSearchServer(search_server, documents);
+
+    runner.Run("FindTopDocuments/seq/default", queries.size(), [&](size_t i) {
+        search_server.FindTopDocuments(queries[i]);
+        });
+    runner.Run("FindTopDocuments/seq/status", queries.size(), [&](size_t i) {
+        search_server.FindTopDocuments(queries[i], DocumentStatus::BANNED);
+        });
+    runner.Run("FindTopDocuments/seq/predicate", queries.size(), [&](size_t i) {
+        search_server.FindTopDocuments(queries[i], is_even_rating);
+        });
+    runner.Run("FindTopDocuments/par/default", queries.size(), [&](size_t i) {
+        search_server.FindTopDocuments(std::execution::par, queries[i]);
+        });
+    runner.Run("FindTopDocuments/par/status", queries.size(), [&](size_t i) {
+        search_server.FindTopDocuments(std::execution::par, queries[i], DocumentStatus::BANNED);
+        });
+    runner.Run("FindTopDocuments/par/predicate", queries.size(), [&](size_t i) {
+        search_server.FindTopDocuments(std::execution::par, queries[i], is_even_rating);
+        });
+
+    if (runner.IsEnabled("FindTopDocuments/required")) {
+        const std::vector<std::string> similar_queries = MakeRequiredQueries(documents, stop_words, queries.size(), true);
+        const std::vector<std::string> skewed_queries = MakeRequiredQueries(documents, stop_words, queries.size(), false);
+        runner.Run("FindTopDocuments/required/similar", similar_queries.size(), [&](size_t i) {
+            search_server.FindTopDocuments(similar_queries[i]);
+            });
+        runner.Run("FindTopDocuments/required/skewed", skewed_queries.size(), [&](size_t i) {
+            search_server.FindTopDocuments(skewed_queries[i]);
+            });
+    }
+
+    runner.Run("MatchDocument/seq", queries.size(), [&](size_t i) {
+        search_server.MatchDocument(queries[i], documents[i % documents.size()].id);
+        });
+    runner.Run("MatchDocument/par", queries.size(), [&](size_t i) {
+        search_server.MatchDocument(std::execution::par, queries[i], documents[i % documents.size()].id);
+        });
+
+    runner.Run("ProcessQueries", 1, [&](size_t) {
+        ProcessQueries(search_server, queries);
+        });
+
+    {
+        RequestQueue request_queue(search_server);
+        runner.Run("RequestQueue/AddFindRequest", queries.size(), [&](size_t i) {
+            request_queue.AddFindRequest(queries[i]);
+            });
+        ConcurrentRequestQueue concurrent_request_queue(search_server);
+        runner.Run("ConcurrentRequestQueue/AddFindRequest", queries.size(), [&](size_t i) {
+            concurrent_request_queue.AddFindRequest(queries[i]);
+            });
+    }
+
+    const auto fill_changed_search_server = [&]() {
+        changed_search_server = std::make_unique<SearchServer>(stop_words);
+        FillSearchServer(*changed_search_server, documents);
+    };
+    runner.Run("RemoveDocument/seq", documents.size(), [&](size_t i) {
+        changed_search_server->RemoveDocument(documents[i].id);
+        }, fill_changed_search_server);
+    runner.Run("RemoveDocument/par", documents.size(), [&](size_t i) {
+        changed_search_server->RemoveDocument(std::execution::par, documents[i].id);
+        }, fill_changed_search_server);
+
+    if (runner.IsEnabled("RemoveDuplicates")) {
+        CorpusOptions duplicate_options = options.corpus;
+        duplicate_options.duplicate_share = 0.2;
+        CorpusGenerator duplicate_generator(duplicate_options);
+        const std::vector<GeneratedDocument> duplicate_documents = duplicate_generator.GenerateDocuments();
+        runner.Run("RemoveDuplicates", 1, [&](size_t) {
+            RemoveDuplicates(*changed_search_server);
+            }, [&]() {
+                changed_search_server = std::make_unique<SearchServer>(stop_words);
+                FillSearchServer(*changed_search_server, duplicate_documents);
+            });
+    }
+
+    output << "\n  ]\n}\n";
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+    try {
+        RunBenchmarks(ParseOptions(argc, argv), std::cout);
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
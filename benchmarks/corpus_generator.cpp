@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "corpus_generator.h"
+
+
+namespace {
+
+// Rank 0 is "a", rank 25 is "z", rank 26 is "aa" and so on
+std::string MakeWord(size_t rank) {
+    std::string word;
+    ++rank;
+    while (rank > 0) {
+        --rank;
+        word += static_cast<char>('a' + rank % 26);
+        rank /= 26;
+    }
+    return word;
+}
+
+}  // namespace
+
+
+CorpusGenerator::CorpusGenerator(const CorpusOptions& options)
+    : options_(options)
+    , generator_(options.seed)
+{
+    using namespace std::string_literals;
+    if (options_.vocabulary_size <= options_.stop_word_count || options_.min_document_length > options_.max_document_length
+        || options_.min_rating > options_.max_rating) {
+        throw std::invalid_argument("Invalid corpus options"s);
+    }
+
+    vocabulary_.reserve(options_.vocabulary_size);
+    cumulative_weights_.reserve(options_.vocabulary_size);
+    double weight_sum = 0.0;
+    for (size_t rank = 0; rank < options_.vocabulary_size; ++rank) {
+        vocabulary_.push_back(MakeWord(rank));
+        weight_sum += 1.0 / std::pow(static_cast<double>(rank + 1), options_.zipf_exponent);
+        cumulative_weights_.push_back(weight_sum);
+    }
+    for (double& weight : cumulative_weights_) {
+        weight /= weight_sum;
+    }
+}
+
+
+std::string CorpusGenerator::GetStopWords() const {
+    std::string stop_words;
+    for (size_t rank = 0; rank < options_.stop_word_count; ++rank) {
+        stop_words += vocabulary_[rank];
+        stop_words += ' ';
+    }
+    return stop_words;
+}
+
+
+std::vector<GeneratedDocument> CorpusGenerator::GenerateDocuments() {
+    std::vector<GeneratedDocument> documents;
+    documents.reserve(options_.document_count);
+    double status_weight_sum = 0.0;
+    for (const double weight : options_.status_weights) {
+        status_weight_sum += weight;
+    }
+
+    for (size_t i = 0; i < options_.document_count; ++i) {
+        GeneratedDocument document;
+        document.id = static_cast<int>(i);
+        if (!documents.empty() && DrawUniform() < options_.duplicate_share) {
+            document.text = documents[DrawIndex(0, documents.size() - 1)].text;
+        } else {
+            const size_t length = DrawIndex(options_.min_document_length, options_.max_document_length);
+            for (size_t j = 0; j < length; ++j) {
+                if (j > 0) {
+                    document.text += ' ';
+                }
+                document.text += DrawWord();
+            }
+        }
+
+        double status_point = DrawUniform() * status_weight_sum;
+        size_t status = 0;
+        while (status + 1 < options_.status_weights.size() && status_point >= options_.status_weights[status]) {
+            status_point -= options_.status_weights[status];
+            ++status;
+        }
+        document.status = static_cast<DocumentStatus>(status);
+
+        for (size_t j = 0; j < options_.rating_count; ++j) {
+            const size_t rating_range = static_cast<size_t>(options_.max_rating - options_.min_rating);
+            document.ratings.push_back(options_.min_rating + static_cast<int>(DrawIndex(0, rating_range)));
+        }
+        documents.push_back(std::move(document));
+    }
+    return documents;
+}
+
+
+std::vector<std::string> CorpusGenerator::GenerateQueries(const QueryMixOptions& options) {
+    std::vector<std::string> queries;
+    queries.reserve(options.query_count);
+    for (size_t i = 0; i < options.query_count; ++i) {
+        std::string query;
+        const size_t plus_word_count = DrawIndex(options.min_plus_word_count, options.max_plus_word_count);
+        for (size_t j = 0; j < plus_word_count; ++j) {
+            query += DrawWord();
+            query += ' ';
+        }
+        if (options.max_minus_word_count > 0 && DrawUniform() < options.minus_word_probability) {
+            const size_t minus_word_count = DrawIndex(1, options.max_minus_word_count);
+            for (size_t j = 0; j < minus_word_count; ++j) {
+                query += '-';
+                query += DrawWord();
+                query += ' ';
+            }
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
+
+
+const CorpusOptions& CorpusGenerator::GetOptions() const {
+    return options_;
+}
+
+
+double CorpusGenerator::DrawUniform() {
+    return static_cast<double>(generator_() >> 11) / static_cast<double>(uint64_t{ 1 } << 53);
+}
+
+
+size_t CorpusGenerator::DrawIndex(size_t min_value, size_t max_value) {
+    return min_value + static_cast<size_t>(generator_() % (max_value - min_value + 1));
+}
+
+
+const std::string& CorpusGenerator::DrawWord() {
+    const double point = DrawUniform();
+    const auto it = std::upper_bound(cumulative_weights_.begin(), cumulative_weights_.end(), point);
+    const size_t rank = std::min<size_t>(it - cumulative_weights_.begin(), vocabulary_.size() - 1);
+    return vocabulary_[rank];
+}
\ No newline at end of file
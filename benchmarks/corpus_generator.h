@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../document.h"
+
+
+struct CorpusOptions {
+    uint64_t seed = 42;
+    size_t vocabulary_size = 20'000;
+    // Word of rank r is drawn with probability proportional to 1 / r^zipf_exponent
+    double zipf_exponent = 1.0;
+    // The most frequent words of the vocabulary
+    size_t stop_word_count = 10;
+    size_t document_count = 10'000;
+    size_t min_document_length = 20;
+    size_t max_document_length = 100;
+    // Weights of ACTUAL, IRRELEVANT, BANNED and REMOVED
+    std::array<double, 4> status_weights = { 0.85, 0.05, 0.05, 0.05 };
+    int min_rating = -10;
+    int max_rating = 10;
+    size_t rating_count = 3;
+    // Share of documents that repeat the words of an earlier document
+    double duplicate_share = 0.0;
+};
+
+
+struct QueryMixOptions {
+    size_t query_count = 1'000;
+    size_t min_plus_word_count = 1;
+    size_t max_plus_word_count = 5;
+    double minus_word_probability = 0.3;
+    size_t max_minus_word_count = 2;
+};
+
+
+struct GeneratedDocument {
+    int id;
+    std::string text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+
+// Deterministic synthetic corpus: the same options always give the same documents and queries
+// on every platform, because only the raw output of std::mt19937_64 is used.
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(const CorpusOptions& options);
+
+
+    std::string GetStopWords() const;
+
+
+    std::vector<GeneratedDocument> GenerateDocuments();
+
+
+    std::vector<std::string> GenerateQueries(const QueryMixOptions& options);
+
+
+    const CorpusOptions& GetOptions() const;
+
+private:
+    // Uniform in [0, 1)
+    double DrawUniform();
+
+
+    // Uniform in [min_value, max_value]
+    size_t DrawIndex(size_t min_value, size_t max_value);
+
+
+    const std::string& DrawWord();
+
+
+    CorpusOptions options_;
+    std::mt19937_64 generator_;
+    std::vector<std::string> vocabulary_;
+    std::vector<double> cumulative_weights_;
+};
\ No newline at end of file
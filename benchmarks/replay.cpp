@@ -0,0 +1,244 @@
+// Replays a workload log written by WorkloadRecorder against a fresh search server, open-loop:
+// every operation starts at its recorded time divided by the speed, whatever the previous ones do,
+// so the latencies include the time an operation waited behind the others.
+// Queries hold a shared lock of the server and index changes an exclusive one, as they would in a service.
+// Build like benchmark.cpp:
+//   g++ -std=c++17 -O2 -DSEARCH_SERVER_DISABLE_PROFILING -DSEARCH_SERVER_DISABLE_TRACING -pthread replay.cpp corpus_generator.cpp <sources> -ltbb
+// Usage:
+//   replay --log=PATH [--threads=N] [--speed=X]   (speed 1 keeps the recorded rate, 0 runs as fast as possible)
+//   replay --record=PATH [--documents=N] [--queries=N] [--rate=OPS_PER_SECOND]   (records a synthetic mixed workload)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "../request_queue.h"
+#include "../request_statistics.h"
+#include "../search_server.h"
+#include "../workload_log.h"
+#include "corpus_generator.h"
+
+
+namespace {
+
+struct ReplayOptions {
+    std::string log_path;
+    std::string record_path;
+    size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+    double speed = 1.0;
+    CorpusOptions corpus;
+    QueryMixOptions queries;
+    double record_rate = 2'000.0;
+};
+
+
+ReplayOptions ParseOptions(int argc, char* argv[]) {
+    using namespace std::string_literals;
+    ReplayOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        const size_t separator = argument.find('=');
+        const std::string_view name = argument.substr(0, separator);
+        const std::string value(separator == std::string_view::npos ? ""s : std::string(argument.substr(separator + 1)));
+        if (name == "--log") {
+            options.log_path = value;
+        } else if (name == "--record") {
+            options.record_path = value;
+        } else if (name == "--threads") {
+            options.thread_count = std::max<size_t>(1, std::stoul(value));
+        } else if (name == "--speed") {
+            options.speed = std::stod(value);
+        } else if (name == "--documents") {
+            options.corpus.document_count = std::stoul(value);
+        } else if (name == "--queries") {
+            options.queries.query_count = std::stoul(value);
+        } else if (name == "--rate") {
+            options.record_rate = std::stod(value);
+        } else {
+            throw std::invalid_argument("Unknown option "s + std::string(argument));
+        }
+    }
+    if (options.log_path.empty() == options.record_path.empty()) {
+        throw std::invalid_argument("Exactly one of --log and --record is required"s);
+    }
+    return options;
+}
+
+
+// Half of the documents are indexed first; then the queries are interleaved with the other half
+// and with removals of the oldest documents, paced at the given rate
+void RecordSyntheticWorkload(const ReplayOptions& options) {
+    using namespace std::chrono;
+    CorpusGenerator generator(options.corpus);
+    const std::vector<GeneratedDocument> documents = generator.GenerateDocuments();
+    const std::vector<std::string> queries = generator.GenerateQueries(options.queries);
+
+    std::ofstream output(options.record_path, std::ios::binary);
+    SearchServer search_server(generator.GetStopWords());
+    const auto recorder = std::make_shared<WorkloadRecorder>(output);
+    search_server.SetWorkloadRecorder(recorder);
+    RequestQueue request_queue(search_server);
+
+    size_t next_document = documents.size() / 2;
+    for (size_t i = 0; i < next_document; ++i) {
+        search_server.AddDocument(documents[i].id, documents[i].text, documents[i].status, documents[i].ratings);
+    }
+    const size_t queries_per_write = std::max<size_t>(1, queries.size() / std::max<size_t>(1, documents.size() - next_document));
+    size_t next_removal = 0;
+    const auto start_time = steady_clock::now();
+    for (size_t i = 0; i < queries.size(); ++i) {
+        std::this_thread::sleep_until(start_time + duration_cast<steady_clock::duration>(duration<double>(i / options.record_rate)));
+        request_queue.AddFindRequest(queries[i]);
+        if (i % queries_per_write == 0 && next_document < documents.size()) {
+            const GeneratedDocument& document = documents[next_document++];
+            search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+            if (next_document % 4 == 0) {
+                search_server.RemoveDocument(documents[next_removal++].id);
+            }
+        }
+    }
+    std::cout << "{\"recorded_operations\": " << recorder->GetOperationCount() << "}" << std::endl;
+}
+
+
+struct OperationStatistics {
+    Histogram latencies;
+    uint64_t failures = 0;
+};
+
+
+const char* GetOperationName(WorkloadOperationType type) {
+    switch (type) {
+    case WorkloadOperationType::SET_STOP_WORDS:
+        return "set_stop_words";
+    case WorkloadOperationType::ADD_DOCUMENT:
+        return "add_document";
+    case WorkloadOperationType::REMOVE_DOCUMENT:
+        return "remove_document";
+    default:
+        return "find_top_documents";
+    }
+}
+
+
+// Throws the exceptions of the search server
+void ExecuteOperation(SearchServer& search_server, std::shared_mutex& search_server_mutex, const WorkloadOperation& operation) {
+    switch (operation.type) {
+    case WorkloadOperationType::SET_STOP_WORDS: {
+        std::unique_lock lock(search_server_mutex);
+        search_server.SetStopWords(operation.text);
+        break;
+    }
+    case WorkloadOperationType::ADD_DOCUMENT: {
+        std::unique_lock lock(search_server_mutex);
+        search_server.AddDocument(operation.document_id, operation.text, operation.status, operation.ratings);
+        break;
+    }
+    case WorkloadOperationType::REMOVE_DOCUMENT: {
+        std::unique_lock lock(search_server_mutex);
+        search_server.RemoveDocument(operation.document_id);
+        break;
+    }
+    case WorkloadOperationType::FIND_TOP_DOCUMENTS: {
+        std::shared_lock lock(search_server_mutex);
+        search_server.FindTopDocuments(operation.text, operation.status);
+        break;
+    }
+    }
+}
+
+
+void Replay(const ReplayOptions& options) {
+    using namespace std::chrono;
+    using namespace std::string_literals;
+    std::ifstream input(options.log_path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Can't open "s + options.log_path);
+    }
+    WorkloadReader reader(input);
+    std::vector<WorkloadOperation> operations;
+    while (auto operation = reader.ReadNext()) {
+        operations.push_back(std::move(*operation));
+    }
+
+    SearchServer search_server;
+    std::shared_mutex search_server_mutex;
+    constexpr size_t OPERATION_TYPE_COUNT = static_cast<size_t>(WorkloadOperationType::FIND_TOP_DOCUMENTS) + 1;
+    std::vector<std::vector<OperationStatistics>> thread_statistics(options.thread_count, std::vector<OperationStatistics>(OPERATION_TYPE_COUNT));
+    std::atomic<size_t> next_operation{ 0 };
+    const auto start_time = steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t thread_index = 0; thread_index < options.thread_count; ++thread_index) {
+        threads.emplace_back([&, thread_index]() {
+            auto& statistics = thread_statistics[thread_index];
+            // Operations are taken in the recorded order, but neighbours may finish in another order
+            for (size_t i = next_operation.fetch_add(1); i < operations.size(); i = next_operation.fetch_add(1)) {
+                const WorkloadOperation& operation = operations[i];
+                auto scheduled_time = steady_clock::now();
+                if (options.speed > 0.0) {
+                    scheduled_time = start_time + duration_cast<steady_clock::duration>(operation.timestamp / options.speed);
+                    std::this_thread::sleep_until(scheduled_time);
+                }
+                OperationStatistics& operation_statistics = statistics[static_cast<size_t>(operation.type)];
+                try {
+                    ExecuteOperation(search_server, search_server_mutex, operation);
+                } catch (const std::exception&) {
+                    ++operation_statistics.failures;
+                }
+                operation_statistics.latencies.Record(duration_cast<nanoseconds>(steady_clock::now() - scheduled_time).count());
+            }
+            });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double elapsed_seconds = duration<double>(steady_clock::now() - start_time).count();
+
+    std::cout << "{\n  \"operations\": " << operations.size() << ", \"threads\": " << options.thread_count << ", \"speed\": " << options.speed
+        << ", \"seconds\": " << elapsed_seconds << ", \"ops_per_second\": " << operations.size() / elapsed_seconds << ",\n  \"by_type\": {";
+    bool is_first = true;
+    for (size_t type = 1; type < OPERATION_TYPE_COUNT; ++type) {
+        OperationStatistics total;
+        for (const auto& statistics : thread_statistics) {
+            total.latencies.Merge(statistics[type].latencies);
+            total.failures += statistics[type].failures;
+        }
+        if (total.latencies.GetTotalCount() == 0) {
+            continue;
+        }
+        std::cout << (is_first ? "\n" : ",\n") << "    \"" << GetOperationName(static_cast<WorkloadOperationType>(type)) << "\": {"
+            << "\"count\": " << total.latencies.GetTotalCount() << ", \"failures\": " << total.failures
+            << ", \"ops_per_second\": " << total.latencies.GetTotalCount() / elapsed_seconds
+            << ", \"p50_us\": " << total.latencies.GetValueAtPercentile(50.0) / 1000.0
+            << ", \"p99_us\": " << total.latencies.GetValueAtPercentile(99.0) / 1000.0
+            << ", \"p999_us\": " << total.latencies.GetValueAtPercentile(99.9) / 1000.0 << "}";
+        is_first = false;
+    }
+    std::cout << "\n  }\n}" << std::endl;
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+    try {
+        const ReplayOptions options = ParseOptions(argc, argv);
+        if (!options.record_path.empty()) {
+            RecordSyntheticWorkload(options);
+        } else {
+            Replay(options);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Replay failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
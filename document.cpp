@@ -1,3 +1,89 @@
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
 #include "document.h"
 
-Document::Document(int id, double relevance, int rating) : id(id), relevance(relevance), rating(rating) {}
\ No newline at end of file
+Document::Document(int id, double relevance, int rating) : id(id), relevance(relevance), rating(rating) {}
+
+
+size_t MatchedDocuments::size() const {
+    return statuses.size();
+}
+
+
+std::vector<std::string_view> MatchedDocuments::GetWords(size_t index) const {
+    std::vector<std::string_view> words;
+    words.reserve(offsets[index + 1] - offsets[index]);
+    for (size_t i = offsets[index]; i < offsets[index + 1]; ++i) {
+        words.push_back(terms[term_indexes[i]]);
+    }
+    return words;
+}
+
+
+SearchCursor::SearchCursor(const Document& last_document)
+    : is_start_(false)
+    , last_document_(last_document)
+{
+}
+
+
+bool SearchCursor::IsStart() const {
+    return is_start_;
+}
+
+
+SearchCursor SearchCursor::FromString(std::string_view token) {
+    using namespace std::string_literals;
+    if (token.empty()) {
+        return {};
+    }
+    std::istringstream input{ std::string(token) };
+    uint64_t relevance_bits = 0;
+    Document document;
+    char first_separator = '\0', second_separator = '\0';
+    input >> std::hex >> relevance_bits >> first_separator >> std::dec >> document.rating >> second_separator >> document.id;
+    if (!input || first_separator != ':' || second_separator != ':' || input.peek() != std::char_traits<char>::eof()) {
+        throw std::invalid_argument("Invalid search cursor "s + std::string(token));
+    }
+    std::memcpy(&document.relevance, &relevance_bits, sizeof(document.relevance));
+    return SearchCursor(document);
+}
+
+
+std::string SearchCursor::ToString() const {
+    if (is_start_) {
+        return {};
+    }
+    // The relevance is stored bit for bit, so the cursor points exactly after the same document
+    uint64_t relevance_bits = 0;
+    std::memcpy(&relevance_bits, &last_document_.relevance, sizeof(relevance_bits));
+    std::ostringstream output;
+    output << std::hex << relevance_bits << ':' << std::dec << last_document_.rating << ':' << last_document_.id;
+    return output.str();
+}
+
+
+bool SearchCursor::IsBefore(const Document& lhs, const Document& rhs, double eps) {
+    const double lhs_bucket = GetRelevanceBucket(lhs.relevance, eps);
+    const double rhs_bucket = GetRelevanceBucket(rhs.relevance, eps);
+    if (lhs_bucket == rhs_bucket) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs_bucket > rhs_bucket;
+}
+
+
+bool SearchCursor::IsBefore(const Document& document, double eps) const {
+    return is_start_ || IsBefore(last_document_, document, eps);
+}
+
+
+double GetRelevanceBucket(double relevance, double eps) {
+    return std::floor(relevance / eps);
+}
\ No newline at end of file
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 
 struct Document {
@@ -18,4 +22,64 @@ enum class DocumentStatus {
     IRRELEVANT,
     BANNED,
     REMOVED
+};
+
+
+// Result of matching one query against several documents.
+// The i-th document matched terms[term_indexes[j]] for every j from offsets[i] to offsets[i + 1] - 1.
+struct MatchedDocuments {
+    std::vector<DocumentStatus> statuses;
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> term_indexes;
+    std::vector<std::string_view> terms;
+
+
+    size_t size() const;
+
+
+    std::vector<std::string_view> GetWords(size_t index) const;
+};
+
+
+// Position after the last document of a page of search results. The default cursor is the start of the results.
+// ToString gives an opaque token that FromString turns back into the same cursor.
+class SearchCursor {
+public:
+    SearchCursor() = default;
+
+
+    explicit SearchCursor(const Document& last_document);
+
+
+    bool IsStart() const;
+
+
+    // Throws std::invalid_argument if the token wasn't produced by ToString
+    static SearchCursor FromString(std::string_view token);
+
+
+    std::string ToString() const;
+
+
+    // The order of search results: by relevance, equal relevances (in the same eps-wide bucket) by rating, then by id
+    static bool IsBefore(const Document& lhs, const Document& rhs, double eps);
+
+
+    bool IsBefore(const Document& document, double eps) const;
+
+private:
+    bool is_start_ = true;
+    Document last_document_;
+};
+
+
+// Relevances in the same bucket are treated as equal. Unlike |lhs - rhs| < eps this equality is transitive,
+// so the orders built on it are strict weak orderings, as sorting and heaps require.
+double GetRelevanceBucket(double relevance, double eps);
+
+
+struct SearchPage {
+    std::vector<Document> documents;
+    // Empty if there are no more results
+    std::optional<SearchCursor> next_cursor;
 };
\ No newline at end of file
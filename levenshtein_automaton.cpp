@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "levenshtein_automaton.h"
+
+
+LevenshteinAutomaton::LevenshteinAutomaton(std::string_view word, int max_distance, size_t prefix_length)
+    : word_(word)
+    , max_distance_(max_distance)
+    , prefix_length_(std::min(prefix_length, word.size()))
+{
+    using namespace std::string_literals;
+    if (max_distance < 0 || max_distance > MAX_DISTANCE) {
+        throw std::invalid_argument("Edit distance must be from 0 to "s + std::to_string(MAX_DISTANCE));
+    }
+}
+
+
+size_t LevenshteinAutomaton::GetStateSize() const {
+    return word_.size() + 2;
+}
+
+
+void LevenshteinAutomaton::Start(int* state) const {
+    for (size_t i = 0; i <= word_.size(); ++i) {
+        state[i] = std::min(static_cast<int>(i), max_distance_ + 1);
+    }
+    state[word_.size() + 1] = 0;
+}
+
+
+void LevenshteinAutomaton::Step(const int* state, char c, int* next_state) const {
+    // The distances are capped at max_distance + 1, since larger ones are never accepted
+    const int limit = max_distance_ + 1;
+    const size_t consumed_count = static_cast<size_t>(state[word_.size() + 1]);
+    next_state[word_.size() + 1] = static_cast<int>(consumed_count + 1);
+    if (consumed_count < prefix_length_ && word_[consumed_count] != c) {
+        std::fill(next_state, next_state + word_.size() + 1, limit);
+        return;
+    }
+    next_state[0] = std::min(state[0] + 1, limit);
+    for (size_t i = 1; i <= word_.size(); ++i) {
+        const int substitution = state[i - 1] + (word_[i - 1] == c ? 0 : 1);
+        next_state[i] = std::min({ substitution, state[i] + 1, next_state[i - 1] + 1, limit });
+    }
+}
+
+
+bool LevenshteinAutomaton::IsDead(const int* state) const {
+    return *std::min_element(state, state + word_.size() + 1) > max_distance_;
+}
+
+
+bool LevenshteinAutomaton::GetViableCharacters(const int* state, std::string& characters) const {
+    const size_t consumed_count = static_cast<size_t>(state[word_.size() + 1]);
+    if (consumed_count < prefix_length_) {
+        characters.assign(1, word_[consumed_count]);
+        return true;
+    }
+    // While some distance is below the maximum, an edit on any character keeps it within the maximum.
+    // Otherwise only a character equal to the next one of a prefix at the maximum distance does.
+    if (*std::min_element(state, state + word_.size() + 1) < max_distance_) {
+        return false;
+    }
+    characters.clear();
+    for (size_t i = 0; i < word_.size(); ++i) {
+        if (state[i] == max_distance_) {
+            characters += word_[i];
+        }
+    }
+    std::sort(characters.begin(), characters.end(), [](char lhs, char rhs) {
+        return static_cast<unsigned char>(lhs) < static_cast<unsigned char>(rhs);
+        });
+    characters.erase(std::unique(characters.begin(), characters.end()), characters.end());
+    return true;
+}
+
+
+int LevenshteinAutomaton::GetDistance(const int* state) const {
+    return state[word_.size()];
+}
+
+
+int LevenshteinAutomaton::GetMaxDistance() const {
+    return max_distance_;
+}
\ No newline at end of file
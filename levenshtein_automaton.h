@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+
+// Accepts the words within max_distance Levenshtein edits of a word that start with the first
+// prefix_length characters of the word. A state is a row of the edit distance matrix: the distances
+// between the consumed characters and every prefix of the word, followed by the number of the consumed characters.
+class LevenshteinAutomaton {
+public:
+    inline static constexpr int MAX_DISTANCE = 2;
+
+
+    // Throws std::invalid_argument unless 0 <= max_distance <= MAX_DISTANCE
+    LevenshteinAutomaton(std::string_view word, int max_distance, size_t prefix_length = 0);
+
+
+    // The number of ints in a state
+    size_t GetStateSize() const;
+
+
+    void Start(int* state) const;
+
+
+    void Step(const int* state, char c, int* next_state) const;
+
+
+    // No word starting with the consumed characters is accepted
+    bool IsDead(const int* state) const;
+
+
+    // Returns false if a step on any character may keep the automaton alive,
+    // otherwise the only such characters are assigned to characters in ascending order
+    bool GetViableCharacters(const int* state, std::string& characters) const;
+
+
+    // The distance between the word and the consumed characters, max_distance + 1 if it is larger
+    int GetDistance(const int* state) const;
+
+
+    int GetMaxDistance() const;
+
+private:
+    std::string word_;
+    int max_distance_;
+    size_t prefix_length_;
+};
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <chrono>
 #include <iostream>
+#include <string>
+#include <utility>
 
 
 #define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
@@ -12,7 +14,8 @@
 
 class LogDuration {
 public:
-    LogDuration(const std::string& id) : id_(id) {}
+    // The id is copied, so a temporary such as name + "x"s is safe; the guard is not on a hot path
+    LogDuration(std::string id) : id_(std::move(id)) {}
 
     ~LogDuration() {
         using namespace std;
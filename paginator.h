@@ -2,19 +2,23 @@
 
 #include <iostream>
 #include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 #include "search_server.h"
 #include "document.h"
 
 
+// The size is computed on request: in O(1) for random access iterators and in O(n) for the others
 template <typename Iterator>
 class IteratorRange {
 public:
     IteratorRange(Iterator begin, Iterator end)
         : first_(begin)
-        , last_(end)
-        , size_(distance(first_, last_)) {
+        , last_(end) {
     }
 
 
@@ -29,12 +33,11 @@ public:
 
 
     size_t size() const {
-        return size_;
+        return std::distance(first_, last_);
     }
 
 private:
     Iterator first_, last_;
-    size_t size_;
 };
 
 
@@ -54,37 +57,124 @@ std::ostream& operator<<(std::ostream& out, Document document) {
 }
 
 
+// Lazy view of a range split into pages: nothing is allocated and the boundaries of a page are found
+// only when the page is reached. Any forward iterators will do; random access ones also give O(1) page(i) and size().
+// A page is a range of the source, so the source is read twice: streaming sources such as std::istream_iterator
+// are out of scope and are rejected at compile time.
 template <typename Iterator>
 class Paginator {
+    static_assert(std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>,
+        "Paginator requires multi-pass (forward) iterators");
+
 public:
-    Paginator(Iterator begin, Iterator end, int64_t page_size) {
-        for (int64_t left = distance(begin, end); left > 0;) {
-            const size_t current_page_size = std::min(page_size, left);
-            const Iterator current_page_end = next(begin, current_page_size);
-            pages_.push_back({ begin, current_page_end });
-
-            left -= current_page_size;
-            begin = current_page_end;
+    class PageIterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = IteratorRange<Iterator>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = value_type;
+
+
+        PageIterator(Iterator page_begin, Iterator last, size_t page_size)
+            : page_begin_(page_begin)
+            , page_end_(Advance(page_begin, last, page_size))
+            , last_(last)
+            , page_size_(page_size) {
+        }
+
+
+        value_type operator*() const {
+            return { page_begin_, page_end_ };
+        }
+
+
+        PageIterator& operator++() {
+            page_begin_ = page_end_;
+            page_end_ = Advance(page_begin_, last_, page_size_);
+            return *this;
+        }
+
+
+        PageIterator operator++(int) {
+            PageIterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+
+        bool operator==(const PageIterator& other) const {
+            return page_begin_ == other.page_begin_;
+        }
+
+
+        bool operator!=(const PageIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        Iterator page_begin_, page_end_, last_;
+        size_t page_size_;
+    };
+
+
+    Paginator(Iterator begin, Iterator end, size_t page_size)
+        : first_(begin)
+        , last_(end)
+        , page_size_(page_size) {
+        using namespace std::string_literals;
+        if (page_size == 0) {
+            throw std::invalid_argument("Page size must be positive"s);
         }
     }
 
 
-    auto begin() const {
-        return pages_.begin();
+    PageIterator begin() const {
+        return { first_, last_, page_size_ };
     }
 
 
-    auto end() const {
-        return pages_.end();
+    PageIterator end() const {
+        return { last_, last_, page_size_ };
     }
 
 
     size_t size() const {
-        return pages_.size();
+        const size_t item_count = std::distance(first_, last_);
+        return (item_count + page_size_ - 1) / page_size_;
+    }
+
+
+    // Throws std::out_of_range if there is no such page
+    IteratorRange<Iterator> page(size_t index) const {
+        static_assert(IS_RANDOM_ACCESS, "page(i) requires random access iterators");
+        using namespace std::string_literals;
+        if (index >= size()) {
+            throw std::out_of_range("Page index is out of range"s);
+        }
+        const Iterator page_begin = first_ + index * page_size_;
+        return { page_begin, Advance(page_begin, last_, page_size_) };
     }
 
 private:
-    std::vector<IteratorRange<Iterator>> pages_;
+    inline static constexpr bool IS_RANDOM_ACCESS = std::is_base_of_v<std::random_access_iterator_tag,
+        typename std::iterator_traits<Iterator>::iterator_category>;
+
+
+    static Iterator Advance(Iterator it, Iterator last, size_t count) {
+        if constexpr (IS_RANDOM_ACCESS) {
+            return it + std::min<std::ptrdiff_t>(count, last - it);
+        } else {
+            for (; count > 0 && it != last; --count) {
+                ++it;
+            }
+            return it;
+        }
+    }
+
+
+    Iterator first_, last_;
+    size_t page_size_;
 };
 
 
@@ -0,0 +1,88 @@
+#include <algorithm>
+
+#include "positional_index.h"
+
+
+PositionalIndex::PositionIterator::PositionIterator(const uint8_t* begin, const uint8_t* end)
+    : current_(begin)
+    , end_(end)
+{
+}
+
+
+bool PositionalIndex::PositionIterator::Next(uint32_t& position) {
+    if (current_ == end_) {
+        return false;
+    }
+    uint32_t delta = 0;
+    for (int shift = 0; current_ != end_; shift += 7) {
+        const uint8_t byte = *current_++;
+        delta |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    last_position_ = is_first_ ? delta : last_position_ + delta;
+    is_first_ = false;
+    position = last_position_;
+    return true;
+}
+
+
+void PositionalIndex::AddDocument(int document_id, const std::vector<std::pair<std::string_view, std::vector<uint32_t>>>& word_positions) {
+    DocumentPositions document;
+    document.words.reserve(word_positions.size());
+    for (const auto& [word, positions] : word_positions) {
+        const uint32_t offset = static_cast<uint32_t>(document.data.size());
+        uint32_t last_position = 0;
+        for (const uint32_t position : positions) {
+            uint32_t delta = position - last_position;
+            last_position = position;
+            while (delta >= 0x80) {
+                document.data.push_back(static_cast<uint8_t>((delta & 0x7f) | 0x80));
+                delta >>= 7;
+            }
+            document.data.push_back(static_cast<uint8_t>(delta));
+        }
+        document.words.push_back({ word, offset, static_cast<uint32_t>(document.data.size()) - offset });
+    }
+    std::sort(document.words.begin(), document.words.end(), [](const WordPositions& lhs, const WordPositions& rhs) {
+        return lhs.word < rhs.word;
+        });
+    document.words.shrink_to_fit();
+    document.data.shrink_to_fit();
+    documents_[document_id] = std::move(document);
+}
+
+
+void PositionalIndex::RemoveDocument(int document_id) {
+    documents_.erase(document_id);
+}
+
+
+PositionalIndex::PositionIterator PositionalIndex::GetPositions(int document_id, std::string_view word) const {
+    const auto document_it = documents_.find(document_id);
+    if (document_it == documents_.end()) {
+        return {};
+    }
+    const DocumentPositions& document = document_it->second;
+    const auto word_it = std::lower_bound(document.words.begin(), document.words.end(), word, [](const WordPositions& lhs, std::string_view rhs) {
+        return lhs.word < rhs;
+        });
+    if (word_it == document.words.end() || word_it->word != word) {
+        return {};
+    }
+    const uint8_t* begin = document.data.data() + word_it->offset;
+    return { begin, begin + word_it->size };
+}
+
+
+size_t PositionalIndex::GetMemoryUsage() const {
+    // Every node of the map holds a key, a value and about four pointers of its own
+    size_t memory_usage = sizeof(*this);
+    for (const auto& [_, document] : documents_) {
+        memory_usage += sizeof(int) + sizeof(DocumentPositions) + 4 * sizeof(void*);
+        memory_usage += document.words.capacity() * sizeof(WordPositions) + document.data.capacity();
+    }
+    return memory_usage;
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+// Positions of the words in the documents. The positions of a word in a document are stored
+// as varint-encoded deltas and decoded only when they are iterated.
+class PositionalIndex {
+public:
+    // Decodes the positions of one word in one document in ascending order
+    class PositionIterator {
+    public:
+        PositionIterator() = default;
+
+
+        PositionIterator(const uint8_t* begin, const uint8_t* end);
+
+
+        // Returns false when there are no more positions
+        bool Next(uint32_t& position);
+
+    private:
+        const uint8_t* current_ = nullptr;
+        const uint8_t* end_ = nullptr;
+        uint32_t last_position_ = 0;
+        bool is_first_ = true;
+    };
+
+
+    // The words must stay valid while the document is indexed; every word's positions must be ascending
+    void AddDocument(int document_id, const std::vector<std::pair<std::string_view, std::vector<uint32_t>>>& word_positions);
+
+
+    void RemoveDocument(int document_id);
+
+
+    // An empty iterator if the document doesn't contain the word
+    PositionIterator GetPositions(int document_id, std::string_view word) const;
+
+
+    // Approximate number of bytes used by the index
+    size_t GetMemoryUsage() const;
+
+private:
+    struct WordPositions {
+        std::string_view word;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+
+    struct DocumentPositions {
+        // Sorted by word
+        std::vector<WordPositions> words;
+        std::vector<uint8_t> data;
+    };
+
+
+    std::map<int, DocumentPositions> documents_;
+};
\ No newline at end of file
@@ -1,20 +1,11 @@
-#include <algorithm>
-#include <execution>
-
 #include "process_queries.h"
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
 
-    using namespace std;
-
-    vector<vector<Document>> result(queries.size());
-    transform(execution::par, queries.begin(), queries.end(), result.begin(), [&search_server](const string& query) {
-        return search_server.FindTopDocuments(query);
-        });
-
-    return result;
+    TRACE_OPERATION("ProcessQueries");
+    return search_server.FindTopDocumentsBatch(queries);
 }
 
 std::vector<Document> ProcessQueriesJoined(
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "profile.h"
+
+
+struct Profiler::Registry {
+    std::mutex mutex;
+    std::vector<std::string_view> section_names;
+    std::vector<std::shared_ptr<const ThreadCounters>> thread_counters;
+};
+
+
+size_t Profiler::RegisterSection(std::string_view name) {
+    using namespace std::string_literals;
+    Registry& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    const auto it = std::find(registry.section_names.begin(), registry.section_names.end(), name);
+    if (it != registry.section_names.end()) {
+        return it - registry.section_names.begin();
+    }
+    if (registry.section_names.size() == MAX_SECTION_COUNT) {
+        throw std::length_error("Too many profiled sections"s);
+    }
+    registry.section_names.push_back(name);
+    return registry.section_names.size() - 1;
+}
+
+
+void Profiler::Record(size_t section, std::chrono::steady_clock::duration duration) {
+    // Every counter has a single writer, so a plain load and store are enough
+    Counters& counters = ForCurrentThread().sections[section];
+    const uint64_t duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    counters.call_count.store(counters.call_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    counters.total_ns.store(counters.total_ns.load(std::memory_order_relaxed) + duration_ns, std::memory_order_relaxed);
+    if (duration_ns > counters.max_ns.load(std::memory_order_relaxed)) {
+        counters.max_ns.store(duration_ns, std::memory_order_relaxed);
+    }
+}
+
+
+std::vector<Profiler::SectionReport> Profiler::GetReport() {
+    Registry& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    std::vector<SectionReport> report;
+    for (const std::string_view name : registry.section_names) {
+        report.push_back({ name });
+    }
+    for (const auto& thread_counters : registry.thread_counters) {
+        for (size_t i = 0; i < report.size(); ++i) {
+            const Counters& counters = thread_counters->sections[i];
+            report[i].call_count += counters.call_count.load(std::memory_order_relaxed);
+            report[i].total_duration += std::chrono::nanoseconds(counters.total_ns.load(std::memory_order_relaxed));
+            report[i].max_duration = std::max(report[i].max_duration, std::chrono::nanoseconds(counters.max_ns.load(std::memory_order_relaxed)));
+        }
+    }
+    return report;
+}
+
+
+void Profiler::PrintReport(std::ostream& output) {
+    using namespace std::string_literals;
+    for (const SectionReport& section : GetReport()) {
+        const auto total_us = std::chrono::duration_cast<std::chrono::microseconds>(section.total_duration).count();
+        const auto max_us = std::chrono::duration_cast<std::chrono::microseconds>(section.max_duration).count();
+        output << section.name << ": "s << section.call_count << " calls, "s << total_us << " microsec total, "s << max_us << " microsec max"s << '\n';
+    }
+}
+
+
+Profiler::Registry& Profiler::GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+
+Profiler::ThreadCounters& Profiler::ForCurrentThread() {
+    // The registry shares the counters, so they outlive their thread and stay in the report
+    thread_local const std::shared_ptr<ThreadCounters> thread_counters = []() {
+        auto counters = std::make_shared<ThreadCounters>();
+        Registry& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        registry.thread_counters.push_back(counters);
+        return counters;
+    }();
+    return *thread_counters;
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "log_duration.h"
+
+
+// PROFILE_SCOPE("name") measures the enclosing scope. The durations are accumulated in per-thread
+// counters without locks and are merged only by Profiler::GetReport. The name must be a string literal.
+// Defining SEARCH_SERVER_DISABLE_PROFILING removes the measurements entirely.
+#ifdef SEARCH_SERVER_DISABLE_PROFILING
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name) \
+    static const size_t PROFILE_CONCAT(profileSection, __LINE__) = Profiler::RegisterSection(name); \
+    Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileSection, __LINE__))
+#endif
+
+
+class Profiler {
+public:
+    inline static constexpr size_t MAX_SECTION_COUNT = 256;
+
+
+    struct SectionReport {
+        std::string_view name;
+        uint64_t call_count = 0;
+        std::chrono::nanoseconds total_duration{ 0 };
+        std::chrono::nanoseconds max_duration{ 0 };
+    };
+
+
+    class Scope {
+    public:
+        explicit Scope(size_t section)
+            : section_(section)
+        {
+        }
+
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+
+        ~Scope() {
+            Profiler::Record(section_, std::chrono::steady_clock::now() - start_time_);
+        }
+
+    private:
+        const size_t section_;
+        const std::chrono::steady_clock::time_point start_time_ = std::chrono::steady_clock::now();
+    };
+
+
+    // Returns the same index for equal names; throws std::length_error if there are too many sections
+    static size_t RegisterSection(std::string_view name);
+
+
+    static void Record(size_t section, std::chrono::steady_clock::duration duration);
+
+
+    // Sections of all threads, including the finished ones, in the order of registration
+    static std::vector<SectionReport> GetReport();
+
+
+    static void PrintReport(std::ostream& output);
+
+private:
+    struct Counters {
+        std::atomic<uint64_t> call_count{ 0 };
+        std::atomic<uint64_t> total_ns{ 0 };
+        std::atomic<uint64_t> max_ns{ 0 };
+    };
+
+
+    // Written only by its thread
+    struct ThreadCounters {
+        std::array<Counters, MAX_SECTION_COUNT> sections;
+    };
+
+
+    // Names of the sections and the counters of all threads, including the finished ones
+    struct Registry;
+
+
+    static Registry& GetRegistry();
+
+
+    static ThreadCounters& ForCurrentThread();
+};
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include "query_arena.h"
+
+
+QueryArena::Scope::Scope()
+    : arena_(QueryArena::ForCurrentThread())
+{
+    ++arena_.scope_depth_;
+}
+
+
+QueryArena::Scope::~Scope() {
+    if (--arena_.scope_depth_ == 0) {
+        arena_.resource_.release();
+    }
+}
+
+
+std::pmr::memory_resource* QueryArena::Scope::GetResource() const {
+    return &arena_.resource_;
+}
+
+
+QueryArena::QueryArena()
+    : buffer_(std::make_unique<std::byte[]>(BUFFER_SIZE))
+    , resource_(buffer_.get(), BUFFER_SIZE, std::pmr::new_delete_resource())
+{
+}
+
+
+QueryArena& QueryArena::ForCurrentThread() {
+    thread_local QueryArena arena;
+    return arena;
+}
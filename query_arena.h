@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+
+// Per-thread monotonic arena for the temporaries of a query.
+// Memory is handed out by bumping a pointer and is released all at once
+// when the outermost scope on the thread ends. Only what dies with the scope
+// may use it: a parsed query is kept by PreparedQuery and the words found by
+// MatchDocument are returned to the caller, so both stay on the global heap.
+class QueryArena {
+public:
+    inline static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+
+    class Scope {
+    public:
+        Scope();
+
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+
+        ~Scope();
+
+
+        std::pmr::memory_resource* GetResource() const;
+
+    private:
+        QueryArena& arena_;
+    };
+
+
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+private:
+    QueryArena();
+
+
+    static QueryArena& ForCurrentThread();
+
+
+    std::unique_ptr<std::byte[]> buffer_;
+    std::pmr::monotonic_buffer_resource resource_;
+    int scope_depth_ = 0;
+};
@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "query_executor.h"
+
+
+QueryExecutor::QueryExecutor(size_t thread_count, size_t queue_capacity, OverflowPolicy overflow_policy)
+    : queue_capacity_(queue_capacity)
+    , overflow_policy_(overflow_policy)
+{
+    using namespace std::string_literals;
+    if (queue_capacity_ == 0) {
+        throw std::invalid_argument("Query queue capacity must be positive"s);
+    }
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this] {
+            WorkerLoop();
+            });
+    }
+}
+
+
+QueryExecutor::~QueryExecutor() {
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        is_stopping_ = true;
+    }
+    queue_not_empty_.notify_all();
+    queue_not_full_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+
+size_t QueryExecutor::GetThreadCount() const {
+    return workers_.size();
+}
+
+
+size_t QueryExecutor::GetQueueCapacity() const {
+    return queue_capacity_;
+}
+
+
+size_t QueryExecutor::GetQueueSize() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return tasks_.size();
+}
+
+
+void QueryExecutor::Push(std::function<void()> task) {
+    using namespace std::string_literals;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (tasks_.size() >= queue_capacity_) {
+        if (overflow_policy_ == OverflowPolicy::REJECT) {
+            throw std::runtime_error("Query queue is full"s);
+        }
+        queue_not_full_.wait(lock, [this] {
+            return tasks_.size() < queue_capacity_ || is_stopping_;
+            });
+    }
+    if (is_stopping_) {
+        throw std::runtime_error("Query executor is stopping"s);
+    }
+    tasks_.push_back(std::move(task));
+    lock.unlock();
+    queue_not_empty_.notify_one();
+}
+
+
+void QueryExecutor::WorkerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_not_empty_.wait(lock, [this] {
+                return !tasks_.empty() || is_stopping_;
+                });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        queue_not_full_.notify_one();
+        task();
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+// Fixed pool of worker threads fed by a bounded queue of tasks.
+// When the queue is full a submission either waits for a free slot or is rejected.
+class QueryExecutor {
+public:
+    enum class OverflowPolicy {
+        BLOCK,
+        REJECT
+    };
+
+
+    inline static constexpr size_t DEFAULT_QUEUE_CAPACITY = 4096;
+
+
+    // thread_count == 0 means one thread per hardware core
+    explicit QueryExecutor(size_t thread_count = 0, size_t queue_capacity = DEFAULT_QUEUE_CAPACITY, OverflowPolicy overflow_policy = OverflowPolicy::BLOCK);
+
+
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+
+    // Runs the tasks that are already queued and joins the workers
+    ~QueryExecutor();
+
+
+    template <typename Task>
+    std::future<std::invoke_result_t<Task>> Submit(Task task) {
+        using Result = std::invoke_result_t<Task>;
+        // std::function needs a copyable target, so the move-only packaged_task is shared
+        auto packaged_task = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        auto future = packaged_task->get_future();
+        Push([packaged_task] {
+            (*packaged_task)();
+            });
+        return future;
+    }
+
+
+    size_t GetThreadCount() const;
+
+
+    size_t GetQueueCapacity() const;
+
+
+    size_t GetQueueSize() const;
+
+private:
+    void Push(std::function<void()> task);
+
+
+    void WorkerLoop();
+
+
+    const size_t queue_capacity_;
+    const OverflowPolicy overflow_policy_;
+    std::deque<std::function<void()>> tasks_;
+    mutable std::mutex mutex_;
+    std::condition_variable queue_not_empty_;
+    std::condition_variable queue_not_full_;
+    bool is_stopping_ = false;
+    std::vector<std::thread> workers_;
+};
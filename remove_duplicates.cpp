@@ -1,27 +1,190 @@
+#include <algorithm>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+
 #include "Remove_duplicates.h"
 
 
 void RemoveDuplicates(SearchServer& search_server) {
-    std::set<int> ids_to_delete;
-    for (auto first_it = search_server.begin(); first_it != search_server.end(); ++first_it) {
-        if (!ids_to_delete.count(*first_it)) {
-            for (auto second_it = std::next(first_it); second_it != search_server.end(); ++second_it) {
-                if (!ids_to_delete.count(*second_it)) {
-                    std::set<std::string> first_document_content, second_document_content;
-                    for (const auto& [word, _] : search_server.GetWordFrequencies(*first_it)) {
-                        first_document_content.insert(word);
-                    }
-                    for (const auto& [word, _] : search_server.GetWordFrequencies(*second_it)) {
-                        second_document_content.insert(word);
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+
+    std::vector<uint64_t> fingerprints(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), fingerprints.begin(), [&search_server](int document_id) {
+        return ComputeWordSetFingerprint(search_server.GetWordFrequencies(document_id));
+        });
+
+    // Documents with equal fingerprints become neighbours, the lowest id first
+    std::vector<size_t> order(document_ids.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(std::execution::par, order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+        return std::pair(fingerprints[lhs], document_ids[lhs]) < std::pair(fingerprints[rhs], document_ids[rhs]);
+        });
+
+    const auto have_same_words = [&search_server](int lhs_id, int rhs_id) {
+        const auto& lhs_words = search_server.GetWordFrequencies(lhs_id);
+        const auto& rhs_words = search_server.GetWordFrequencies(rhs_id);
+        return std::equal(lhs_words.begin(), lhs_words.end(), rhs_words.begin(), rhs_words.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first == rhs.first;
+            });
+    };
+
+    std::vector<int> ids_to_delete;
+    for (size_t group_begin = 0; group_begin < order.size();) {
+        size_t group_end = group_begin + 1;
+        while (group_end < order.size() && fingerprints[order[group_end]] == fingerprints[order[group_begin]]) {
+            ++group_end;
+        }
+
+        // Different word sets with the same fingerprint are rare, so the group is compared
+        // against every distinct word set found in it so far
+        std::vector<int> originals;
+        for (size_t i = group_begin; i < group_end; ++i) {
+            const int document_id = document_ids[order[i]];
+            const bool is_duplicate = std::any_of(originals.begin(), originals.end(), [&](int original_id) {
+                return have_same_words(original_id, document_id);
+                });
+            if (is_duplicate) {
+                ids_to_delete.push_back(document_id);
+            } else {
+                originals.push_back(document_id);
+            }
+        }
+        group_begin = group_end;
+    }
+
+    search_server.RemoveDocuments(ids_to_delete);
+}
+
+
+namespace {
+
+uint64_t MixHash(uint64_t value) {
+    // splitmix64 finalizer
+    value += 0x9e3779b97f4a7c15ull;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+
+std::vector<uint64_t> ComputeMinHashSignature(const std::map<std::string_view, double>& words, const std::vector<uint64_t>& seeds) {
+    std::vector<uint64_t> signature(seeds.size(), std::numeric_limits<uint64_t>::max());
+    for (const auto& [word, _] : words) {
+        const uint64_t word_hash = std::hash<std::string_view>{}(word);
+        for (size_t i = 0; i < seeds.size(); ++i) {
+            signature[i] = std::min(signature[i], MixHash(word_hash ^ seeds[i]));
+        }
+    }
+    return signature;
+}
+
+
+double ComputeJaccardSimilarity(const std::map<std::string_view, double>& lhs, const std::map<std::string_view, double>& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1.0;
+    }
+    size_t common_count = 0;
+    auto lhs_it = lhs.begin();
+    auto rhs_it = rhs.begin();
+    while (lhs_it != lhs.end() && rhs_it != rhs.end()) {
+        if (lhs_it->first < rhs_it->first) {
+            ++lhs_it;
+        } else if (rhs_it->first < lhs_it->first) {
+            ++rhs_it;
+        } else {
+            ++common_count;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    return static_cast<double>(common_count) / (lhs.size() + rhs.size() - common_count);
+}
+
+
+size_t FindClusterRoot(std::vector<size_t>& parents, size_t index) {
+    while (parents[index] != index) {
+        parents[index] = parents[parents[index]];
+        index = parents[index];
+    }
+    return index;
+}
+
+}  // namespace
+
+
+std::vector<std::vector<int>> FindNearDuplicates(const SearchServer& search_server, const NearDuplicateOptions& options) {
+    using namespace std::string_literals;
+    if (options.band_count == 0 || options.rows_per_band == 0) {
+        throw std::invalid_argument("MinHash signature must have at least one band and one row"s);
+    }
+
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+
+    std::vector<uint64_t> seeds(options.band_count * options.rows_per_band);
+    for (size_t i = 0; i < seeds.size(); ++i) {
+        seeds[i] = MixHash(options.seed + i);
+    }
+    std::vector<std::vector<uint64_t>> signatures(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), signatures.begin(), [&](int document_id) {
+        return ComputeMinHashSignature(search_server.GetWordFrequencies(document_id), seeds);
+        });
+
+    // Candidates from every band are verified with the exact similarity and joined into clusters
+    std::vector<size_t> parents(document_ids.size());
+    std::iota(parents.begin(), parents.end(), 0);
+    for (size_t band = 0; band < options.band_count; ++band) {
+        std::unordered_map<uint64_t, std::vector<size_t>> buckets;
+        for (size_t i = 0; i < signatures.size(); ++i) {
+            uint64_t band_hash = band;
+            for (size_t row = 0; row < options.rows_per_band; ++row) {
+                band_hash = MixHash(band_hash ^ signatures[i][band * options.rows_per_band + row]);
+            }
+            buckets[band_hash].push_back(i);
+        }
+
+        for (const auto& [_, bucket] : buckets) {
+            for (size_t i = 1; i < bucket.size(); ++i) {
+                for (size_t j = 0; j < i; ++j) {
+                    const size_t lhs_root = FindClusterRoot(parents, bucket[i]);
+                    const size_t rhs_root = FindClusterRoot(parents, bucket[j]);
+                    if (lhs_root == rhs_root) {
+                        continue;
                     }
-                    if (first_document_content == second_document_content) {
-                        ids_to_delete.insert(*second_it);
+                    const double similarity = ComputeJaccardSimilarity(
+                        search_server.GetWordFrequencies(document_ids[bucket[i]]),
+                        search_server.GetWordFrequencies(document_ids[bucket[j]]));
+                    if (similarity >= options.similarity_threshold) {
+                        parents[lhs_root] = rhs_root;
+                        break;
                     }
                 }
             }
         }
     }
-    for (int id : ids_to_delete) {
-        search_server.RemoveDocument(id);
+
+    std::map<size_t, std::vector<int>> root_to_cluster;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        root_to_cluster[FindClusterRoot(parents, i)].push_back(document_ids[i]);
+    }
+    std::vector<std::vector<int>> clusters;
+    for (auto& [_, cluster] : root_to_cluster) {
+        if (cluster.size() > 1) {
+            std::sort(cluster.begin(), cluster.end());
+            clusters.push_back(std::move(cluster));
+        }
+    }
+    std::sort(clusters.begin(), clusters.end());
+    return clusters;
+}
+
+
+void RemoveNearDuplicates(SearchServer& search_server, const NearDuplicateOptions& options) {
+    std::vector<int> ids_to_delete;
+    for (const std::vector<int>& cluster : FindNearDuplicates(search_server, options)) {
+        ids_to_delete.insert(ids_to_delete.end(), std::next(cluster.begin()), cluster.end());
     }
+    search_server.RemoveDocuments(ids_to_delete);
 }
\ No newline at end of file
@@ -1,6 +1,30 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #include "Search_server.h"
 
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+void RemoveDuplicates(SearchServer& search_server);
+
+
+struct NearDuplicateOptions {
+    // The signature of a document has band_count * rows_per_band MinHash values.
+    // Documents become candidates if all the rows of at least one band are equal.
+    size_t band_count = 16;
+    size_t rows_per_band = 4;
+    // Minimal Jaccard similarity of the word sets of two linked documents. A cluster is a chain
+    // of such links, so its documents at the ends of a chain may be less similar.
+    double similarity_threshold = 0.8;
+    uint64_t seed = 0x5eed;
+};
+
+
+// Groups of documents whose word sets are similar. Every cluster is sorted by id
+// and consists of at least two documents; the clusters are sorted by their first id.
+std::vector<std::vector<int>> FindNearDuplicates(const SearchServer& search_server, const NearDuplicateOptions& options = {});
+
+
+// Keeps only the document with the lowest id from every cluster of near duplicates
+void RemoveNearDuplicates(SearchServer& search_server, const NearDuplicateOptions& options = {});
\ No newline at end of file
@@ -1,3 +1,5 @@
+#include <stdexcept>
+
 #include "request_queue.h"
 
 
@@ -5,9 +7,12 @@ RequestQueue::RequestQueue(const SearchServer& search_server) : search_server_(s
 
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-    return AddFindRequest(raw_query, [status]([[maybe_unused]] int document_id, [[maybe_unused]] DocumentStatus document_status, [[maybe_unused]] int rating) {
-        return document_status == status;
-        });
+    if (WorkloadRecorder* recorder = search_server_.GetWorkloadRecorder()) {
+        recorder->RecordFindTopDocuments(raw_query, status);
+    }
+    const auto start = statistics_ ? RequestStatistics::Clock::now() : RequestStatistics::Clock::time_point();
+    // Goes through the status overload so that the search server can serve it from its result cache
+    return AddRequestResult(search_server_.FindTopDocuments(raw_query, status), start);
 }
 
 
@@ -18,4 +23,144 @@ std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query)
 
 int RequestQueue::GetNoResultRequests() const {
     return noResultRequests_;
+}
+
+
+void RequestQueue::EnableStatistics(RequestStatistics::Clock::duration window, RequestStatistics::Clock::duration granularity) {
+    statistics_ = std::make_unique<RequestStatistics>(window, granularity);
+}
+
+
+RequestStatistics::Report RequestQueue::GetStatistics() const {
+    using namespace std::string_literals;
+    if (!statistics_) {
+        throw std::logic_error("Statistics of the request queue are not enabled"s);
+    }
+    return statistics_->GetReport();
+}
+
+
+std::vector<Document> RequestQueue::AddRequestResult(std::vector<Document> documents, RequestStatistics::Clock::time_point start) {
+    if (statistics_) {
+        statistics_->Record(RequestStatistics::Clock::now() - start, documents.size());
+    }
+
+    //increase time value and delete old requests
+    seconds++;
+    while (requests_.size() >= sec_in_day_) {
+        if (requests_.front().isEmpty) {
+            noResultRequests_--;
+        }
+        requests_.pop_front();
+    }
+
+    //save search results into queue
+    QueryResult queryResult;
+    queryResult.query_result = std::move(documents);
+    queryResult.isEmpty = false;
+    if (queryResult.query_result.empty()) {
+        queryResult.isEmpty = true;
+        noResultRequests_++;
+    }
+    requests_.push_back(queryResult);
+    return queryResult.query_result;
+}
+
+
+ConcurrentRequestQueue::ConcurrentRequestQueue(const SearchServer& search_server, Clock::duration window, Clock::duration granularity,
+    Clock::duration statistics_window, Clock::duration statistics_granularity)
+    : search_server_(search_server)
+    , start_(Clock::now())
+    , granularity_(granularity)
+    , bucket_count_(granularity > Clock::duration::zero() ? (window + granularity - Clock::duration(1)) / granularity : 0)
+    , statistics_(statistics_window, statistics_granularity)
+{
+    using namespace std::string_literals;
+    if (granularity <= Clock::duration::zero() || window <= Clock::duration::zero()) {
+        throw std::invalid_argument("Window and granularity of the request queue must be positive"s);
+    }
+    buckets_ = std::make_unique<Bucket[]>(bucket_count_);
+}
+
+
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
+    if (WorkloadRecorder* recorder = search_server_.GetWorkloadRecorder()) {
+        recorder->RecordFindTopDocuments(raw_query, status);
+    }
+    const auto start = Clock::now();
+    std::vector<Document> documents = search_server_.FindTopDocuments(raw_query, status);
+    RecordRequest(documents, start);
+    return documents;
+}
+
+
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(const std::string& raw_query) {
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
+}
+
+
+int ConcurrentRequestQueue::GetNoResultRequests() const {
+    return SumCounters(&Bucket::no_result_count);
+}
+
+
+int ConcurrentRequestQueue::GetRequestCount() const {
+    return SumCounters(&Bucket::request_count);
+}
+
+
+ConcurrentRequestQueue::Clock::duration ConcurrentRequestQueue::GetWindow() const {
+    return granularity_ * bucket_count_;
+}
+
+
+ConcurrentRequestQueue::Clock::duration ConcurrentRequestQueue::GetGranularity() const {
+    return granularity_;
+}
+
+
+RequestStatistics::Report ConcurrentRequestQueue::GetStatistics() const {
+    return statistics_.GetReport();
+}
+
+
+void ConcurrentRequestQueue::RecordRequest(const std::vector<Document>& documents, Clock::time_point start) {
+    statistics_.Record(Clock::now() - start, documents.size());
+
+    const uint32_t period = GetCurrentPeriod();
+    Bucket& bucket = buckets_[period % bucket_count_];
+    IncrementCounter(bucket.request_count, period);
+    if (documents.empty()) {
+        IncrementCounter(bucket.no_result_count, period);
+    }
+}
+
+
+uint32_t ConcurrentRequestQueue::GetCurrentPeriod() const {
+    // Wraps around, the periods are compared by their unsigned difference
+    return static_cast<uint32_t>((Clock::now() - start_) / granularity_);
+}
+
+
+void ConcurrentRequestQueue::IncrementCounter(std::atomic<uint64_t>& counter, uint32_t period) {
+    uint64_t value = counter.load(std::memory_order_relaxed);
+    uint64_t new_value;
+    do {
+        const bool is_same_period = static_cast<uint32_t>(value >> 32) == period;
+        new_value = is_same_period ? value + 1 : (static_cast<uint64_t>(period) << 32) + 1;
+    } while (!counter.compare_exchange_weak(value, new_value, std::memory_order_relaxed));
+}
+
+
+int ConcurrentRequestQueue::SumCounters(std::atomic<uint64_t> Bucket::* counter) const {
+    const uint32_t current_period = GetCurrentPeriod();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < bucket_count_; ++i) {
+        const uint64_t value = (buckets_[i].*counter).load(std::memory_order_relaxed);
+        const uint32_t period = static_cast<uint32_t>(value >> 32);
+        if (static_cast<uint32_t>(current_period - period) < bucket_count_) {
+            sum += static_cast<uint32_t>(value);
+        }
+    }
+    return static_cast<int>(sum);
 }
\ No newline at end of file
@@ -3,8 +3,13 @@
 #include <vector>
 #include <string>
 #include <deque>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 
 #include "search_server.h"
+#include "request_statistics.h"
 
 
 class RequestQueue {
@@ -13,25 +18,11 @@ public:
 
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-        //increase time value and delete old requests
-        seconds++;
-        while (requests_.size() >= sec_in_day_) {
-            if (requests_.front().isEmpty) {
-                noResultRequests_--;
-            }
-            requests_.pop_front();
+        if (WorkloadRecorder* recorder = search_server_.GetWorkloadRecorder()) {
+            recorder->RecordFindTopDocuments(raw_query, DocumentStatus::ACTUAL, true);
         }
-
-        //find search results and save them into queue
-        QueryResult queryResult;
-        queryResult.query_result = search_server_.FindTopDocuments(raw_query, document_predicate);
-        queryResult.isEmpty = false;
-        if (queryResult.query_result.empty()) {
-            queryResult.isEmpty = true;
-            noResultRequests_++;
-        }
-        requests_.push_back(queryResult);
-        return queryResult.query_result;
+        const auto start = statistics_ ? RequestStatistics::Clock::now() : RequestStatistics::Clock::time_point();
+        return AddRequestResult(search_server_.FindTopDocuments(raw_query, document_predicate), start);
     }
 
 
@@ -43,15 +34,109 @@ public:
 
     int GetNoResultRequests() const;
 
+
+    // Starts collecting the latencies and result counts of the requests; every thread recording
+    // them takes about slot count * 10 KB. The collected statistics are discarded.
+    void EnableStatistics(RequestStatistics::Clock::duration window = std::chrono::minutes(1),
+        RequestStatistics::Clock::duration granularity = std::chrono::seconds(5));
+
+
+    // Latencies, result counts and rate of the requests over the window of the statistics.
+    // Throws std::logic_error if the statistics are not enabled.
+    RequestStatistics::Report GetStatistics() const;
+
 private:
     struct QueryResult {
         bool isEmpty;
         std::vector<Document> query_result;
     };
 
+
+    std::vector<Document> AddRequestResult(std::vector<Document> documents, RequestStatistics::Clock::time_point start);
+
+
     std::deque<QueryResult> requests_;
     int noResultRequests_ = 0;
     constexpr static int sec_in_day_ = 1440;
     int seconds = 0;
     const SearchServer& search_server_;
+    // nullptr while the statistics are disabled
+    std::unique_ptr<RequestStatistics> statistics_;
+};
+
+
+// Thread-safe counterpart of RequestQueue. It counts requests over a window of real (steady clock) time
+// with a ring of per-period counters and stores no results, so its memory doesn't depend on the load.
+class ConcurrentRequestQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+
+    // The window is rounded up to a whole number of periods of the given granularity
+    // The statistics of latencies and result counts have their own, shorter window
+    explicit ConcurrentRequestQueue(const SearchServer& search_server,
+        Clock::duration window = std::chrono::hours(24), Clock::duration granularity = std::chrono::minutes(1),
+        Clock::duration statistics_window = std::chrono::minutes(1), Clock::duration statistics_granularity = std::chrono::seconds(5));
+
+
+    template <typename DocumentPredicate>
+    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+        if (WorkloadRecorder* recorder = search_server_.GetWorkloadRecorder()) {
+            recorder->RecordFindTopDocuments(raw_query, DocumentStatus::ACTUAL, true);
+        }
+        const auto start = Clock::now();
+        std::vector<Document> documents = search_server_.FindTopDocuments(raw_query, document_predicate);
+        RecordRequest(documents, start);
+        return documents;
+    }
+
+
+    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
+
+
+    std::vector<Document> AddFindRequest(const std::string& raw_query);
+
+
+    // Both counters cover the current period and the previous ones within the window
+    int GetNoResultRequests() const;
+
+
+    int GetRequestCount() const;
+
+
+    Clock::duration GetWindow() const;
+
+
+    Clock::duration GetGranularity() const;
+
+
+    RequestStatistics::Report GetStatistics() const;
+
+private:
+    // Every counter keeps the number of its period in the high half and the count in the low half,
+    // so a stale period is replaced and counted by one compare-exchange without a lock
+    struct Bucket {
+        std::atomic<uint64_t> request_count{ 0 };
+        std::atomic<uint64_t> no_result_count{ 0 };
+    };
+
+
+    void RecordRequest(const std::vector<Document>& documents, Clock::time_point start);
+
+
+    uint32_t GetCurrentPeriod() const;
+
+
+    static void IncrementCounter(std::atomic<uint64_t>& counter, uint32_t period);
+
+
+    int SumCounters(std::atomic<uint64_t> Bucket::* counter) const;
+
+
+    const SearchServer& search_server_;
+    const Clock::time_point start_;
+    const Clock::duration granularity_;
+    const size_t bucket_count_;
+    std::unique_ptr<Bucket[]> buckets_;
+    RequestStatistics statistics_;
 };
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "request_statistics.h"
+
+
+namespace {
+
+int GetMostSignificantBit(uint64_t value) {
+    int bit = 0;
+    for (int step = 32; step > 0; step /= 2) {
+        if (value >> step) {
+            value >>= step;
+            bit += step;
+        }
+    }
+    return bit;
+}
+
+
+void AddRelaxed(std::atomic<uint64_t>& counter, uint64_t value) {
+    // The counter has a single writer, so a plain load and store are enough
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+
+void Histogram::Record(uint64_t value, uint64_t count) {
+    counts_[GetBucketIndex(value)] += count;
+    total_count_ += count;
+}
+
+
+void Histogram::Merge(const Histogram& other) {
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    total_count_ += other.total_count_;
+}
+
+
+uint64_t Histogram::GetTotalCount() const {
+    return total_count_;
+}
+
+
+uint64_t Histogram::GetValueAtPercentile(double percentile) const {
+    if (total_count_ == 0) {
+        return 0;
+    }
+    const double clamped_percentile = std::clamp(percentile, 0.0, 100.0);
+    const uint64_t target_count = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped_percentile / 100.0 * total_count_)));
+    uint64_t count = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        count += counts_[i];
+        if (count >= target_count) {
+            return GetBucketUpperBound(i);
+        }
+    }
+    return MAX_VALUE;
+}
+
+
+uint64_t Histogram::GetCountAtIndex(size_t index) const {
+    return counts_.at(index);
+}
+
+
+size_t Histogram::GetBucketIndex(uint64_t value) {
+    constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{ 1 } << SUB_BUCKET_BITS;
+    constexpr uint64_t HALF_SUB_BUCKET_COUNT = SUB_BUCKET_COUNT / 2;
+    value = std::min(value, MAX_VALUE);
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    // Every next power of two is split into HALF_SUB_BUCKET_COUNT buckets
+    const int shift = GetMostSignificantBit(value) - (SUB_BUCKET_BITS - 1);
+    return static_cast<size_t>(SUB_BUCKET_COUNT + (shift - 1) * HALF_SUB_BUCKET_COUNT + ((value >> shift) - HALF_SUB_BUCKET_COUNT));
+}
+
+
+uint64_t Histogram::GetBucketUpperBound(size_t index) {
+    constexpr size_t SUB_BUCKET_COUNT = size_t{ 1 } << SUB_BUCKET_BITS;
+    constexpr size_t HALF_SUB_BUCKET_COUNT = SUB_BUCKET_COUNT / 2;
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const size_t shift = (index - SUB_BUCKET_COUNT) / HALF_SUB_BUCKET_COUNT + 1;
+    const uint64_t sub_bucket = (index - SUB_BUCKET_COUNT) % HALF_SUB_BUCKET_COUNT + HALF_SUB_BUCKET_COUNT;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+
+RequestStatistics::RequestStatistics(Clock::duration window, Clock::duration granularity)
+    : id_([]() {
+        static std::atomic<uint64_t> next_id{ 1 };
+        return next_id.fetch_add(1);
+        }())
+    , start_(Clock::now())
+    , granularity_(granularity)
+    , slot_count_(granularity > Clock::duration::zero() ? (window + granularity - Clock::duration(1)) / granularity : 0)
+{
+    using namespace std::string_literals;
+    if (granularity <= Clock::duration::zero() || window <= Clock::duration::zero()) {
+        throw std::invalid_argument("Window and granularity of the request statistics must be positive"s);
+    }
+}
+
+
+void RequestStatistics::Record(Clock::duration latency, size_t result_count) {
+    const uint64_t period = GetCurrentPeriod();
+    Slot& slot = GetThreadShard().slots[period % slot_count_];
+    if (slot.period_tag.load(std::memory_order_relaxed) != period + 1) {
+        for (auto& counter : slot.latency_counts) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto& counter : slot.result_counts) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        slot.period_tag.store(period + 1, std::memory_order_release);
+    }
+
+    const auto latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+    AddRelaxed(slot.latency_counts[Histogram::GetBucketIndex(latency_ns > 0 ? static_cast<uint64_t>(latency_ns) : 0)], 1);
+    AddRelaxed(slot.result_counts[std::min(result_count, RESULT_COUNT_LIMIT)], 1);
+}
+
+
+RequestStatistics::Report RequestStatistics::GetReport() const {
+    Report report;
+    report.result_count_distribution.assign(RESULT_COUNT_LIMIT + 1, 0);
+    const uint64_t current_period = GetCurrentPeriod();
+    {
+        std::lock_guard guard(shards_mutex_);
+        for (const auto& shard : shards_) {
+            for (size_t i = 0; i < slot_count_; ++i) {
+                const Slot& slot = shard->slots[i];
+                const uint64_t period_tag = slot.period_tag.load(std::memory_order_acquire);
+                if (period_tag == 0 || current_period - (period_tag - 1) >= slot_count_) {
+                    continue;
+                }
+                for (size_t j = 0; j < Histogram::BUCKET_COUNT; ++j) {
+                    if (const uint64_t count = slot.latency_counts[j].load(std::memory_order_relaxed)) {
+                        report.latencies.Record(Histogram::GetBucketUpperBound(j), count);
+                    }
+                }
+                for (size_t j = 0; j <= RESULT_COUNT_LIMIT; ++j) {
+                    report.result_count_distribution[j] += slot.result_counts[j].load(std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    report.request_count = report.latencies.GetTotalCount();
+    report.latency_p50 = std::chrono::nanoseconds(report.latencies.GetValueAtPercentile(50.0));
+    report.latency_p90 = std::chrono::nanoseconds(report.latencies.GetValueAtPercentile(90.0));
+    report.latency_p99 = std::chrono::nanoseconds(report.latencies.GetValueAtPercentile(99.0));
+    report.latency_p999 = std::chrono::nanoseconds(report.latencies.GetValueAtPercentile(99.9));
+
+    // The window is shorter while the statistics are younger than it
+    const Clock::duration elapsed = Clock::now() - start_;
+    const Clock::duration covered = std::min<Clock::duration>(elapsed, granularity_ * (slot_count_ - 1) + elapsed % granularity_);
+    const double covered_seconds = std::chrono::duration<double>(covered).count();
+    report.queries_per_second = covered_seconds > 0.0 ? report.request_count / covered_seconds : 0.0;
+    return report;
+}
+
+
+RequestStatistics::Shard::Shard(size_t slot_count)
+    : slots(std::make_unique<Slot[]>(slot_count))
+{
+}
+
+
+RequestStatistics::Shard& RequestStatistics::GetThreadShard() {
+    // Every thread caches the shards of the last instances it used. The ids are never reused, so the
+    // entries of the destroyed instances are never matched and are evicted by the next misses.
+    struct CacheEntry {
+        uint64_t id = 0;
+        Shard* shard = nullptr;
+    };
+    thread_local std::array<CacheEntry, THREAD_CACHE_SIZE> cache;
+    thread_local size_t next_evicted = 0;
+    for (const CacheEntry& entry : cache) {
+        if (entry.id == id_) {
+            return *entry.shard;
+        }
+    }
+
+    Shard* shard = nullptr;
+    {
+        std::lock_guard guard(shards_mutex_);
+        Shard*& thread_shard = thread_shards_[std::this_thread::get_id()];
+        if (!thread_shard) {
+            shards_.push_back(std::make_unique<Shard>(slot_count_));
+            thread_shard = shards_.back().get();
+        }
+        shard = thread_shard;
+    }
+    cache[next_evicted] = { id_, shard };
+    next_evicted = (next_evicted + 1) % THREAD_CACHE_SIZE;
+    return *shard;
+}
+
+
+uint64_t RequestStatistics::GetCurrentPeriod() const {
+    return static_cast<uint64_t>((Clock::now() - start_) / granularity_);
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+// HDR-style histogram: small values are counted exactly, larger ones in buckets
+// whose width is at most 1/32 of the value, so every percentile is accurate to ~3%.
+class Histogram {
+public:
+    inline static constexpr int SUB_BUCKET_BITS = 6;
+    inline static constexpr int MAX_VALUE_BITS = 40;
+    inline static constexpr uint64_t MAX_VALUE = (uint64_t{ 1 } << MAX_VALUE_BITS) - 1;
+    inline static constexpr size_t BUCKET_COUNT = (size_t{ 1 } << SUB_BUCKET_BITS)
+        + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * (size_t{ 1 } << (SUB_BUCKET_BITS - 1));
+
+
+    // Values above MAX_VALUE are counted as MAX_VALUE
+    void Record(uint64_t value, uint64_t count = 1);
+
+
+    void Merge(const Histogram& other);
+
+
+    uint64_t GetTotalCount() const;
+
+
+    // The highest value of the bucket holding the given percentile (from 0 to 100); 0 if the histogram is empty
+    uint64_t GetValueAtPercentile(double percentile) const;
+
+
+    uint64_t GetCountAtIndex(size_t index) const;
+
+
+    static size_t GetBucketIndex(uint64_t value);
+
+
+    static uint64_t GetBucketUpperBound(size_t index);
+
+private:
+    std::array<uint64_t, BUCKET_COUNT> counts_{};
+    uint64_t total_count_ = 0;
+};
+
+
+// Latencies and result counts of requests over a sliding window of steady clock time.
+// Every thread records into its own shard without locks or read-modify-write operations;
+// the shards are merged when a report is requested.
+class RequestStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+
+    // Result counts from RESULT_COUNT_LIMIT on are counted together
+    inline static constexpr size_t RESULT_COUNT_LIMIT = 16;
+
+
+    struct Report {
+        uint64_t request_count = 0;
+        double queries_per_second = 0.0;
+        std::chrono::nanoseconds latency_p50{ 0 };
+        std::chrono::nanoseconds latency_p90{ 0 };
+        std::chrono::nanoseconds latency_p99{ 0 };
+        std::chrono::nanoseconds latency_p999{ 0 };
+        // In nanoseconds
+        Histogram latencies;
+        // The number of requests with i results, the last element counts RESULT_COUNT_LIMIT and more
+        std::vector<uint64_t> result_count_distribution;
+    };
+
+
+    explicit RequestStatistics(Clock::duration window = std::chrono::minutes(1), Clock::duration granularity = std::chrono::seconds(5));
+
+
+    RequestStatistics(const RequestStatistics&) = delete;
+    RequestStatistics& operator=(const RequestStatistics&) = delete;
+
+
+    void Record(Clock::duration latency, size_t result_count);
+
+
+    // Covers the current period and the previous ones within the window.
+    // A period that is being reset concurrently may be reported partially.
+    Report GetReport() const;
+
+private:
+    // The number of instances whose shards a thread keeps at hand
+    inline static constexpr size_t THREAD_CACHE_SIZE = 4;
+
+
+    struct Slot {
+        // The number of the period plus one, 0 for a slot that was never used
+        std::atomic<uint64_t> period_tag{ 0 };
+        std::array<std::atomic<uint64_t>, Histogram::BUCKET_COUNT> latency_counts{};
+        std::array<std::atomic<uint64_t>, RESULT_COUNT_LIMIT + 1> result_counts{};
+    };
+
+
+    // Written by one thread only
+    struct Shard {
+        explicit Shard(size_t slot_count);
+
+
+        std::unique_ptr<Slot[]> slots;
+    };
+
+
+    Shard& GetThreadShard();
+
+
+    uint64_t GetCurrentPeriod() const;
+
+
+    // Unique for every instance, so that the cached shards of a destroyed instance are never used
+    const uint64_t id_;
+    const Clock::time_point start_;
+    const Clock::duration granularity_;
+    const size_t slot_count_;
+    mutable std::mutex shards_mutex_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    // A thread that has finished leaves its shard to the next thread with the same id
+    std::unordered_map<std::thread::id, Shard*> thread_shards_;
+};
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+#include "result_cache.h"
+
+
+ResultCache::ResultCache(size_t memory_limit, size_t shard_count)
+    : memory_limit_(memory_limit)
+    , shard_memory_limit_(shard_count ? memory_limit / shard_count : 0)
+    , shards_(shard_count)
+{
+    using namespace std::string_literals;
+    if (shard_count == 0) {
+        throw std::invalid_argument("Result cache must have at least one shard"s);
+    }
+}
+
+
+std::optional<std::vector<Document>> ResultCache::Find(const std::string& key, uint64_t generation) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+
+    const auto it = shard.key_to_entry.find(key);
+    if (it == shard.key_to_entry.end()) {
+        ++misses_;
+        return std::nullopt;
+    }
+    if (it->second->generation != generation) {
+        EraseEntry(shard, it->second);
+        ++invalidations_;
+        ++misses_;
+        return std::nullopt;
+    }
+
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    ++hits_;
+    return it->second->documents;
+}
+
+
+void ResultCache::Insert(std::string key, uint64_t generation, std::vector<Document> documents) {
+    const size_t memory_usage = ComputeMemoryUsage(key, documents);
+    if (memory_usage > shard_memory_limit_) {
+        return;
+    }
+
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+
+    const auto it = shard.key_to_entry.find(key);
+    if (it != shard.key_to_entry.end()) {
+        EraseEntry(shard, it->second);
+    }
+    while (!shard.entries.empty() && shard.memory_usage + memory_usage > shard_memory_limit_) {
+        EraseEntry(shard, std::prev(shard.entries.end()));
+        ++evictions_;
+    }
+
+    shard.entries.push_front({ std::move(key), generation, std::move(documents), memory_usage });
+    shard.key_to_entry.emplace(shard.entries.front().key, shard.entries.begin());
+    shard.memory_usage += memory_usage;
+}
+
+
+void ResultCache::Clear() {
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        shard.key_to_entry.clear();
+        shard.entries.clear();
+        shard.memory_usage = 0;
+    }
+}
+
+
+ResultCache::Stats ResultCache::GetStats() const {
+    Stats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.invalidations = invalidations_;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        stats.entry_count += shard.entries.size();
+        stats.memory_usage += shard.memory_usage;
+    }
+    return stats;
+}
+
+
+size_t ResultCache::GetMemoryLimit() const {
+    return memory_limit_;
+}
+
+
+ResultCache::Shard& ResultCache::GetShard(const std::string& key) {
+    return shards_[std::hash<std::string>{}(key) % shards_.size()];
+}
+
+
+void ResultCache::EraseEntry(Shard& shard, std::list<Entry>::iterator entry) {
+    shard.memory_usage -= entry->memory_usage;
+    shard.key_to_entry.erase(entry->key);
+    shard.entries.erase(entry);
+}
+
+
+size_t ResultCache::ComputeMemoryUsage(const std::string& key, const std::vector<Document>& documents) {
+    // The key is stored twice: in the entry and in the lookup table
+    return sizeof(Entry) + 2 * (sizeof(std::string) + key.size()) + 4 * sizeof(void*)
+        + documents.size() * sizeof(Document);
+}
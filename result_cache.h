@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+
+
+// Identifies a document predicate for the result cache
+struct ResultCacheKey {
+    std::string value;
+};
+
+
+// Sharded LRU cache of search results.
+// Every entry remembers the index generation it was computed for and is dropped
+// as soon as it is requested with another generation.
+class ResultCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t invalidations = 0;
+        size_t entry_count = 0;
+        size_t memory_usage = 0;
+    };
+
+
+    inline static constexpr size_t DEFAULT_SHARD_COUNT = 16;
+
+
+    explicit ResultCache(size_t memory_limit, size_t shard_count = DEFAULT_SHARD_COUNT);
+
+
+    std::optional<std::vector<Document>> Find(const std::string& key, uint64_t generation);
+
+
+    void Insert(std::string key, uint64_t generation, std::vector<Document> documents);
+
+
+    void Clear();
+
+
+    Stats GetStats() const;
+
+
+    size_t GetMemoryLimit() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+        size_t memory_usage;
+    };
+
+
+    struct Shard {
+        std::list<Entry> entries;  // the most recently used entry is the first one
+        std::unordered_map<std::string, std::list<Entry>::iterator> key_to_entry;
+        size_t memory_usage = 0;
+        mutable std::mutex mutex;
+    };
+
+
+    Shard& GetShard(const std::string& key);
+
+
+    static void EraseEntry(Shard& shard, std::list<Entry>::iterator entry);
+
+
+    static size_t ComputeMemoryUsage(const std::string& key, const std::vector<Document>& documents);
+
+
+    const size_t memory_limit_;
+    const size_t shard_memory_limit_;
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+    std::atomic<uint64_t> evictions_ = 0;
+    std::atomic<uint64_t> invalidations_ = 0;
+};
@@ -0,0 +1,26 @@
+#include <stdexcept>
+#include <string>
+
+#include "scorer.h"
+
+
+Bm25Scorer::Bm25Scorer(double k1, double b)
+    : k1_(k1)
+    , b_(b)
+    , one_minus_b_(1.0 - b)
+{
+    using namespace std::string_literals;
+    if (!(k1 >= 0.0) || !(b >= 0.0 && b <= 1.0)) {
+        throw std::invalid_argument("BM25 parameters must satisfy k1 >= 0 and 0 <= b <= 1"s);
+    }
+}
+
+
+double Bm25Scorer::GetK1() const {
+    return k1_;
+}
+
+
+double Bm25Scorer::GetB() const {
+    return b_;
+}
\ No newline at end of file
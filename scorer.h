@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <math.h>
+
+
+// Statistics of the whole index shared by the scores of one query
+struct CorpusStatistics {
+    size_t document_count = 0;
+    // 0 if the indexed documents have no words
+    double inverse_average_document_length = 0.0;
+};
+
+
+// Scorers are policies of SearchServer::FindTopDocumentsScored. ComputeTermWeight is called once
+// for every term of a query, Score for every posting of the term; Score is inlined into the loop
+// accumulating the relevance, so it must be cheap. term_freq is the share of the document's words
+// equal to the term, document_length is the number of the document's words except the stop words.
+// The score must be proportional to term_weight: the server scales the weights of fuzzy matches.
+
+
+// The relevance of the classic search server: term_freq * log(document_count / document_freq)
+class TfIdfScorer {
+public:
+    double ComputeTermWeight(const CorpusStatistics& corpus, size_t document_freq) const {
+        return log(static_cast<double>(corpus.document_count) / document_freq);
+    }
+
+
+    double Score(double term_weight, double term_freq, [[maybe_unused]] uint32_t document_length, [[maybe_unused]] const CorpusStatistics& corpus) const {
+        return term_freq * term_weight;
+    }
+};
+
+
+// Okapi BM25: the term frequency saturates with k1, and b is the strength of the document length normalisation
+class Bm25Scorer {
+public:
+    inline static constexpr double DEFAULT_K1 = 1.2;
+    inline static constexpr double DEFAULT_B = 0.75;
+
+
+    // Throws std::invalid_argument unless k1 >= 0 and 0 <= b <= 1
+    explicit Bm25Scorer(double k1 = DEFAULT_K1, double b = DEFAULT_B);
+
+
+    double ComputeTermWeight(const CorpusStatistics& corpus, size_t document_freq) const {
+        return log(1.0 + (corpus.document_count - document_freq + 0.5) / (document_freq + 0.5));
+    }
+
+
+    double Score(double term_weight, double term_freq, uint32_t document_length, const CorpusStatistics& corpus) const {
+        const double term_count = term_freq * document_length;
+        const double length_norm = one_minus_b_ + b_ * document_length * corpus.inverse_average_document_length;
+        return term_weight * term_count * (k1_ + 1.0) / (term_count + k1_ * length_norm);
+    }
+
+
+    double GetK1() const;
+
+
+    double GetB() const;
+
+private:
+    double k1_;
+    double b_;
+    double one_minus_b_;
+};
\ No newline at end of file
@@ -1,8 +1,12 @@
 #include <stdexcept>
 #include <math.h>
 #include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "search_server.h"
+#include "sorted_intersection.h"
 
 
 SearchServer::SearchServer(const std::string& stop_words_text)
@@ -12,7 +16,7 @@ SearchServer::SearchServer(const std::string& stop_words_text)
 
 
 SearchServer::SearchServer(const std::string_view stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text.data()))
+    : SearchServer(SplitIntoWordViews(stop_words_text))
 {
 }
 
@@ -22,25 +26,229 @@ SearchServer::SearchServer() = default;
 
 void SearchServer::AddDocument(int document_id, const std::string_view & document, DocumentStatus status, const std::vector<int>&ratings) {
     using namespace std::string_literals;
+    TRACE_OPERATION("AddDocument");
     if ((document_id < 0) || (documents_.count(document_id) > 0)) {
         throw std::invalid_argument("Invalid document_id"s);
     }
-    const auto words = SplitIntoWordsNoStop(document.data());
+    std::string analyzed_document;
+    const auto all_words = AnalyzeText(document, analyzed_document);
 
-    const double inv_word_count = 1.0 / words.size();
-    for (const std::string& word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        document_id_to_words_freq_[document_id][word] += inv_word_count;
+    std::vector<std::string_view> word_set;
+    word_set.reserve(all_words.size());
+    for (const std::string_view word : all_words) {
+        if (!IsStopWord(word)) {
+            word_set.push_back(word);
+        }
+    }
+    const size_t word_count = word_set.size();
+    std::sort(word_set.begin(), word_set.end());
+    // Every distinct word is counted, so that it is looked up in the index only once
+    std::vector<uint32_t> word_occurrences;
+    word_occurrences.reserve(word_set.size());
+    size_t distinct_word_count = 0;
+    for (const std::string_view word : word_set) {
+        if (distinct_word_count > 0 && word_set[distinct_word_count - 1] == word) {
+            ++word_occurrences.back();
+        } else {
+            word_set[distinct_word_count++] = word;
+            word_occurrences.push_back(1);
+        }
     }
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
+    word_set.resize(distinct_word_count);
+    const uint64_t words_fingerprint = ComputeWordSetFingerprint(word_set);
+    if (duplicate_policy_ != DuplicatePolicy::ALLOW) {
+        const int original_id = FindDocumentWithWords(words_fingerprint, word_set);
+        if (original_id != INVALID_DOCUMENT_ID && duplicate_policy_ == DuplicatePolicy::REJECT) {
+            throw std::invalid_argument("Document "s + std::to_string(document_id) + " duplicates document "s + std::to_string(original_id));
+        }
+        if (original_id != INVALID_DOCUMENT_ID) {
+            skipped_duplicates_[document_id] = original_id;
+            return;
+        }
+    }
+
+    TRACE_SPAN("IndexDocument");
+    const double inv_word_count = 1.0 / word_count;
+    auto& document_words = document_id_to_words_freq_[document_id];
+    for (size_t i = 0; i < word_set.size(); ++i) {
+        auto it = word_to_document_freqs_.find(word_set[i]);
+        if (it == word_to_document_freqs_.end()) {
+            it = word_to_document_freqs_.emplace(word_set[i], std::map<int, double>()).first;
+        }
+        // The ids usually grow and the words are sorted, so both entries are appended
+        const double term_freq = word_occurrences[i] * inv_word_count;
+        it->second.emplace_hint(it->second.end(), document_id, term_freq);
+        document_words.emplace_hint(document_words.end(), it->first, term_freq);
+    }
+    if (positional_index_) {
+        IndexDocumentPositions(document_id, all_words);
+    }
+    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, words_fingerprint, static_cast<uint32_t>(word_count) });
     document_ids_.push_back(document_id);
+    total_word_count_ += word_count;
+    fingerprint_to_document_ids_[words_fingerprint].push_back(document_id);
+    skipped_duplicates_.erase(document_id);
+    if (workload_recorder_) {
+        workload_recorder_->RecordAddDocument(document_id, document, status, ratings);
+    }
+    ++generation_;
+}
+
+
+void SearchServer::SetDuplicatePolicy(DuplicatePolicy policy) {
+    duplicate_policy_ = policy;
+}
+
+
+SearchServer::DuplicatePolicy SearchServer::GetDuplicatePolicy() const {
+    return duplicate_policy_;
+}
+
+
+const std::map<int, int>& SearchServer::GetSkippedDuplicates() const {
+    return skipped_duplicates_;
+}
+
+
+void SearchServer::SetWorkloadRecorder(std::shared_ptr<WorkloadRecorder> recorder) {
+    workload_recorder_ = std::move(recorder);
+    if (workload_recorder_) {
+        std::string stop_words;
+        for (const std::string& word : stop_words_) {
+            stop_words += word;
+            stop_words += ' ';
+        }
+        workload_recorder_->RecordStopWords(stop_words);
+    }
+}
+
+
+WorkloadRecorder* SearchServer::GetWorkloadRecorder() const {
+    return workload_recorder_.get();
+}
+
+
+void SearchServer::EnablePositionalIndex(double proximity_weight) {
+    using namespace std::string_literals;
+    if (!documents_.empty()) {
+        throw std::logic_error("Positional index can be enabled only before documents are added"s);
+    }
+    if (!(proximity_weight >= 0.0)) {
+        throw std::invalid_argument("Proximity weight must not be negative"s);
+    }
+    positional_index_ = std::make_unique<PositionalIndex>();
+    proximity_weight_ = proximity_weight;
+    ++generation_;
+    ++parse_generation_;
+}
+
+
+bool SearchServer::IsPositionalIndexEnabled() const {
+    return positional_index_ != nullptr;
+}
+
+
+size_t SearchServer::GetPositionalIndexMemoryUsage() const {
+    return positional_index_ ? positional_index_->GetMemoryUsage() : 0;
+}
+
+
+void SearchServer::EnableWildcardMatching() {
+    is_wildcard_matching_enabled_ = true;
+    ++generation_;
+    ++parse_generation_;
+}
+
+
+void SearchServer::DisableWildcardMatching() {
+    is_wildcard_matching_enabled_ = false;
+    ++generation_;
+    ++parse_generation_;
+}
+
+
+bool SearchServer::IsWildcardMatchingEnabled() const {
+    return is_wildcard_matching_enabled_;
+}
+
+
+void SearchServer::SetWildcardExpansionLimit(size_t limit) {
+    using namespace std::string_literals;
+    if (limit == 0) {
+        throw std::invalid_argument("Wildcard expansion limit must be positive"s);
+    }
+    wildcard_expansion_limit_ = limit;
+    ++generation_;
+}
+
+
+size_t SearchServer::GetWildcardExpansionLimit() const {
+    return wildcard_expansion_limit_;
+}
+
+
+void SearchServer::EnableFuzzyMatching(int max_edit_distance, double discount) {
+    using namespace std::string_literals;
+    if (max_edit_distance < 1 || max_edit_distance > LevenshteinAutomaton::MAX_DISTANCE) {
+        throw std::invalid_argument("Fuzzy edit distance must be from 1 to "s + std::to_string(LevenshteinAutomaton::MAX_DISTANCE));
+    }
+    if (!(discount > 0.0 && discount <= 1.0)) {
+        throw std::invalid_argument("Fuzzy discount must be from 0 (exclusive) to 1"s);
+    }
+    fuzzy_max_edit_distance_ = max_edit_distance;
+    fuzzy_discount_ = discount;
+    ++generation_;
+}
+
+
+void SearchServer::DisableFuzzyMatching() {
+    fuzzy_max_edit_distance_ = 0;
+    std::atomic_store(&term_dictionary_, std::shared_ptr<const TermDictionary>());
+    ++generation_;
+}
+
+
+int SearchServer::GetFuzzyMaxEditDistance() const {
+    return fuzzy_max_edit_distance_;
+}
+
+
+void SearchServer::EnableTextAnalyzer(const AnalyzerOptions & options) {
+    using namespace std::string_literals;
+    if (!documents_.empty()) {
+        throw std::logic_error("Text analyzer can be enabled only before documents are added"s);
+    }
+    // The stop words are analyzed like the words of the documents
+    auto text_analyzer = std::make_unique<TextAnalyzer>(options);
+    std::set<std::string, std::less<>> stop_words;
+    for (std::string stop_word : stop_words_) {
+        std::vector<std::string_view> words;
+        text_analyzer->Analyze(stop_word.data(), stop_word.size(), words);
+        for (const std::string_view word : words) {
+            stop_words.emplace(word);
+        }
+    }
+    stop_words_ = std::move(stop_words);
+    text_analyzer_ = std::move(text_analyzer);
+    ++generation_;
+    ++parse_generation_;
+}
+
+
+bool SearchServer::IsTextAnalyzerEnabled() const {
+    return text_analyzer_ != nullptr;
 }
 
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view & raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query, [status]([[maybe_unused]] int document_id, [[maybe_unused]] DocumentStatus document_status, [[maybe_unused]] int rating) {
+    using namespace std::string_literals;
+    const auto document_predicate = [status]([[maybe_unused]] int document_id, [[maybe_unused]] DocumentStatus document_status, [[maybe_unused]] int rating) {
         return document_status == status;
-        });
+    };
+    if (result_cache_) {
+        return FindTopDocumentsCached(raw_query, document_predicate, "s"s + std::to_string(static_cast<int>(status)));
+    }
+    return FindTopDocuments(raw_query, document_predicate);
 }
 
 
@@ -49,80 +257,277 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view & ra
 }
 
 
-int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+SearchPage SearchServer::FindTopDocumentsPage(const std::string_view & raw_query, const SearchCursor & cursor, size_t page_size, DocumentStatus status) const {
+    return FindTopDocumentsPage(raw_query, cursor, page_size, [status]([[maybe_unused]] int document_id, [[maybe_unused]] DocumentStatus document_status, [[maybe_unused]] int rating) {
+        return document_status == status;
+        });
 }
 
 
-void SearchServer::SetStopWords(const std::string & text) {
-    for (const std::string& word : SplitIntoWords(text)) {
-        stop_words_.insert(word);
-    }
+void SearchServer::EnableResultCache(size_t memory_limit, size_t shard_count) {
+    result_cache_ = std::make_unique<ResultCache>(memory_limit, shard_count);
 }
 
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view & raw_query, int document_id) const {
-    using namespace std::literals;
-    
-    std::string string_query = raw_query.data();
-    CheckQuery(string_query);
-    if (!IsIDValid(document_ids_, document_id, false)) {
-        throw std::out_of_range("document's id is out of range");
+void SearchServer::DisableResultCache() {
+    result_cache_.reset();
+}
+
+
+ResultCache::Stats SearchServer::GetResultCacheStats() const {
+    return result_cache_ ? result_cache_->GetStats() : ResultCache::Stats{};
+}
+
+
+uint64_t SearchServer::GetGeneration() const {
+    return generation_;
+}
+
+
+void SearchServer::StartQueryExecutor(size_t thread_count, size_t queue_capacity, QueryExecutor::OverflowPolicy overflow_policy) {
+    query_executor_.reset();
+    query_executor_ = std::make_unique<QueryExecutor>(thread_count, queue_capacity, overflow_policy);
+}
+
+
+std::future<std::vector<Document>> SearchServer::SubmitFindTopDocuments(std::string raw_query, DocumentStatus status) const {
+    return SubmitFindTopDocuments(std::move(raw_query), [status]([[maybe_unused]] int document_id, [[maybe_unused]] DocumentStatus document_status, [[maybe_unused]] int rating) {
+        return document_status == status;
+        });
+}
+
+
+std::future<std::vector<Document>> SearchServer::SubmitFindTopDocuments(std::string raw_query) const {
+    return SubmitFindTopDocuments(std::move(raw_query), DocumentStatus::ACTUAL);
+}
+
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries, DocumentStatus status) const {
+    // Every query is mapped to one of the distinct canonical queries: texts repeated verbatim are
+    // parsed once, and queries differing only in word order or repeated words share the same entry
+    std::unordered_map<std::string_view, size_t> text_to_query;
+    std::map<std::string, size_t> canonical_to_query;
+    std::vector<size_t> query_indexes(raw_queries.size());
+    std::vector<Query> distinct_queries;
+
+    for (size_t i = 0; i < raw_queries.size(); ++i) {
+        const auto [text_it, is_new_text] = text_to_query.emplace(raw_queries[i], 0);
+        if (is_new_text) {
+            Query query = ParseQuery(raw_queries[i]);
+
+            const auto [canonical_it, is_new_query] = canonical_to_query.emplace(BuildCanonicalQuery(query), distinct_queries.size());
+            if (is_new_query) {
+                distinct_queries.push_back(std::move(query));
+            }
+            text_it->second = canonical_it->second;
+        }
+        query_indexes[i] = text_it->second;
     }
-    LOG_DURATION("MathDocument operation time"s);
 
-    const auto query = ParseQuery(string_query);
-    static std::vector<std::string> matched_words;
-    matched_words.clear();
+    // Every distinct term of the batch is looked up in the index only once
+    std::unordered_map<std::string_view, const IndexEntry*> term_to_index_entry;
+    const auto resolve_term = [this, &term_to_index_entry](std::string_view word) {
+        const auto [term_it, is_new_term] = term_to_index_entry.emplace(word, nullptr);
+        if (is_new_term) {
+            const auto index_it = word_to_document_freqs_.find(word);
+            if (index_it != word_to_document_freqs_.end()) {
+                term_it->second = &*index_it;
+            }
+        }
+        return term_it->second;
+    };
 
-    for (const std::string& word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    std::vector<ResolvedQuery> resolved_queries(distinct_queries.size());
+    for (size_t i = 0; i < distinct_queries.size(); ++i) {
+        for (const std::string_view word : distinct_queries[i].plus_words) {
+            if (IsWildcardWord(word)) {
+                ResolveWildcardWord(word, false, resolved_queries[i]);
+            } else if (const IndexEntry* index_entry = resolve_term(word)) {
+                resolved_queries[i].plus_terms.push_back({ index_entry->first, &index_entry->second });
+            }
         }
-        if (word_to_document_freqs_.at(word.data()).count(document_id)) {
-            matched_words.push_back(word);
+        for (const std::string_view word : distinct_queries[i].minus_words) {
+            if (IsWildcardWord(word)) {
+                ResolveWildcardWord(word, true, resolved_queries[i]);
+            } else if (const IndexEntry* index_entry = resolve_term(word)) {
+                resolved_queries[i].minus_terms.push_back(&index_entry->second);
+            }
         }
+        ResolveFuzzyWords(distinct_queries[i], resolved_queries[i]);
+        ResolvePositions(distinct_queries[i], resolved_queries[i]);
+        ResolveRequirements(distinct_queries[i], resolved_queries[i]);
     }
-    for (const std::string& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+
+    std::vector<std::vector<Document>> distinct_results(resolved_queries.size());
+    std::transform(std::execution::par, resolved_queries.begin(), resolved_queries.end(), distinct_results.begin(), [this, status](const ResolvedQuery& query) {
+        QueryArena::Scope arena;
+        auto matched_documents = FindAllDocuments(query, [status]([[maybe_unused]] int document_id, [[maybe_unused]] DocumentStatus document_status, [[maybe_unused]] int rating) {
+            return document_status == status;
+            }, arena.GetResource());
+        return SelectTopDocuments(matched_documents);
+        });
+
+    std::vector<std::vector<Document>> result(raw_queries.size());
+    for (size_t i = 0; i < raw_queries.size(); ++i) {
+        result[i] = distinct_results[query_indexes[i]];
+    }
+    return result;
+}
+
+
+SearchServer::PreparedQuery::PreparedQuery(const SearchServer & search_server, std::string_view raw_query)
+    : search_server_(&search_server)
+    , text_(std::make_shared<const std::string>(raw_query))
+{
+}
+
+
+SearchServer::PreparedQuery::PreparedQuery(const PreparedQuery & other)
+    : search_server_(other.search_server_)
+    , text_(other.text_)
+    , resolution_(std::atomic_load(&other.resolution_))
+{
+}
+
+
+SearchServer::PreparedQuery& SearchServer::PreparedQuery::operator=(const PreparedQuery & other) {
+    search_server_ = other.search_server_;
+    text_ = other.text_;
+    std::atomic_store(&resolution_, std::atomic_load(&other.resolution_));
+    return *this;
+}
+
+
+SearchServer::PreparedQuery SearchServer::PrepareQuery(const std::string_view & raw_query) const {
+    PreparedQuery prepared_query(*this, raw_query);
+    Query query = ParseQuery(*prepared_query.text_);
+    ResolvedQuery resolved_query = ResolveQuery(query);
+    prepared_query.resolution_ = std::make_shared<const PreparedQuery::Resolution>(PreparedQuery::Resolution{ generation_, parse_generation_, std::move(query), std::move(resolved_query) });
+    return prepared_query;
+}
+
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery & prepared_query, DocumentStatus status) const {
+    return FindTopDocuments(prepared_query, [status]([[maybe_unused]] int document_id, [[maybe_unused]] DocumentStatus document_status, [[maybe_unused]] int rating) {
+        return document_status == status;
+        });
+}
+
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery & prepared_query) const {
+    return FindTopDocuments(prepared_query, DocumentStatus::ACTUAL);
+}
+
+
+int SearchServer::GetDocumentCount() const {
+    return documents_.size();
+}
+
+
+void SearchServer::SetStopWords(const std::string & text) {
+    if (text_analyzer_) {
+        std::string analyzed_text;
+        for (const std::string_view word : AnalyzeText(text, analyzed_text)) {
+            stop_words_.emplace(word);
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.clear();
-            break;
+    } else {
+        for (const std::string& word : SplitIntoWords(text)) {
+            stop_words_.insert(word);
         }
     }
+    if (workload_recorder_) {
+        workload_recorder_->RecordStopWords(text);
+    }
+    ++generation_;
+}
 
-    static std::vector<std::string_view> matched_words_to_return;
-    matched_words_to_return.clear();
 
-    for (size_t i = 0; i < matched_words.size(); ++i) {
-        matched_words_to_return.push_back(matched_words[i]);
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view & raw_query, int document_id) const {
+    TRACE_OPERATION("MatchDocument");
+    const auto query = ParseQuery(raw_query);
+    const auto& document_words = GetDocumentWords(document_id);
+    PROFILE_SCOPE("MatchDocument");
+    TRACE_SPAN("MatchWords");
+
+    const DocumentStatus status = documents_.at(document_id).status;
+    for (const std::string_view word : query.minus_words) {
+        bool has_word = false;
+        ForEachMatchingEntry(document_words, word, [&has_word](const auto&) {
+            has_word = true;
+            });
+        if (has_word) {
+            return { std::vector<std::string_view>(), status };
+        }
     }
+    if (!SatisfiesRequirements(query, document_words)) {
+        return { std::vector<std::string_view>(), status };
+    }
+
+    std::vector<std::string_view> matched_words;
+    bool has_wildcard_word = false;
+    for (const std::string_view word : query.plus_words) {
+        has_wildcard_word = has_wildcard_word || IsWildcardWord(word);
+        ForEachMatchingEntry(document_words, word, [&matched_words](const auto& entry) {
+            matched_words.push_back(entry.first);
+            });
+    }
+    if (has_wildcard_word) {
+        std::sort(matched_words.begin(), matched_words.end());
+        matched_words.erase(std::unique(matched_words.begin(), matched_words.end()), matched_words.end());
+    }
+    return { std::move(matched_words), status };
+}
 
-    return { matched_words_to_return, documents_.at(document_id).status };
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const PreparedQuery & prepared_query, int document_id) const {
+    GetDocumentWords(document_id);
+    return MatchResolvedQuery(GetResolution(prepared_query)->query, document_id);
+}
+
+
+MatchedDocuments SearchServer::MatchDocuments(const std::string_view & raw_query, const std::vector<int>&document_ids) const {
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
 }
 
 
-const std::map<std::string, double>& SearchServer::GetWordFrequencies(int document_id) const {
+const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
     return document_id_to_words_freq_.count(document_id) ? document_id_to_words_freq_.at(document_id) : document_id_to_words_freq_.at(-1);
 }
 
 
 void SearchServer::RemoveDocument(int document_id) {
-    if (!IsIDValid(document_ids_, document_id, false)) {
+    if (!documents_.count(document_id)) {
         return;
     }
 
-    for (auto& [_, documentIdToTF] : word_to_document_freqs_) {
-        if (documentIdToTF.count(document_id)) {
-            documentIdToTF.erase(document_id);
-        }
-    }
-    document_id_to_words_freq_.erase(document_id);
-    documents_.erase(document_id);
+    EraseDocumentFromIndex(document_id);
     auto iter = find(document_ids_.begin(), document_ids_.end(), document_id);
     document_ids_.erase(iter);
+    if (workload_recorder_) {
+        workload_recorder_->RecordRemoveDocument(document_id);
+    }
+    ++generation_;
+}
+
+
+void SearchServer::RemoveDocuments(const std::vector<int>&document_ids) {
+    std::unordered_set<int> removed_ids;
+    for (const int document_id : document_ids) {
+        if (documents_.count(document_id) && removed_ids.insert(document_id).second) {
+            EraseDocumentFromIndex(document_id);
+            if (workload_recorder_) {
+                workload_recorder_->RecordRemoveDocument(document_id);
+            }
+        }
+    }
+    if (removed_ids.empty()) {
+        return;
+    }
+
+    document_ids_.erase(remove_if(document_ids_.begin(), document_ids_.end(), [&removed_ids](int document_id) {
+        return removed_ids.count(document_id) > 0;
+        }), document_ids_.end());
+    ++generation_;
 }
 
 
@@ -141,63 +546,136 @@ int SearchServer::GetDocumentId(int index) const {
 }
 
 
-bool SearchServer::IsIDValid(std::vector<int> document_ids, int document_id, bool multithreading) {
-    if (multithreading) {
-        return std::count(std::execution::par, document_ids.begin(), document_ids.end(), document_id);
-    } else {
-        return std::count(document_ids.begin(), document_ids.end(), document_id);
+QueryExecutor& SearchServer::GetQueryExecutor() const {
+    using namespace std::string_literals;
+    if (!query_executor_) {
+        throw std::logic_error("Query executor is not started"s);
     }
+    return *query_executor_;
 }
 
 
-void SearchServer::CheckQuery(const std::string & query) {
-    using namespace std::string_literals;
-    for (const std::string& word : SplitIntoWords(query)) {
-        AreMinusWordsCorrect(word);
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("word "s + word + " is not valid"s);
+const std::map<std::string_view, double>& SearchServer::GetDocumentWords(int document_id) const {
+    const auto it = document_id_to_words_freq_.find(document_id);
+    if (document_id < 0 || it == document_id_to_words_freq_.end()) {
+        throw std::out_of_range("document's id is out of range");
+    }
+    return it->second;
+}
+
+
+void SearchServer::EraseDocumentFromIndex(int document_id) {
+    const auto document_it = document_id_to_words_freq_.find(document_id);
+    for (const auto& [word, _] : document_it->second) {
+        word_to_document_freqs_.find(word)->second.erase(document_id);
+    }
+    document_id_to_words_freq_.erase(document_it);
+    if (positional_index_) {
+        positional_index_->RemoveDocument(document_id);
+    }
+    EraseDocumentFingerprint(document_id);
+    total_word_count_ -= documents_.at(document_id).word_count;
+    documents_.erase(document_id);
+}
+
+
+int SearchServer::FindDocumentWithWords(uint64_t words_fingerprint, const std::vector<std::string_view>& words) const {
+    const auto bucket_it = fingerprint_to_document_ids_.find(words_fingerprint);
+    if (bucket_it == fingerprint_to_document_ids_.end()) {
+        return INVALID_DOCUMENT_ID;
+    }
+    for (const int document_id : bucket_it->second) {
+        const auto& document_words = document_id_to_words_freq_.at(document_id);
+        const bool have_same_words = std::equal(document_words.begin(), document_words.end(), words.begin(), words.end(), [](const auto& lhs, std::string_view rhs) {
+            return lhs.first == rhs;
+            });
+        if (have_same_words) {
+            return document_id;
         }
     }
+    return INVALID_DOCUMENT_ID;
 }
 
 
-void SearchServer::AreMinusWordsCorrect(const std::string & word) {
-    using namespace std::string_literals;
-    //Check the number of minuses
-    if (word.size() > 1 && (word[0] == '-' && word[1] == '-')) {
-        throw std::invalid_argument("too much minuses in the minus-word "s + word);
+void SearchServer::EraseDocumentFingerprint(int document_id) {
+    const auto bucket_it = fingerprint_to_document_ids_.find(documents_.at(document_id).words_fingerprint);
+    auto& document_ids = bucket_it->second;
+    document_ids.erase(std::find(document_ids.begin(), document_ids.end(), document_id));
+    if (document_ids.empty()) {
+        fingerprint_to_document_ids_.erase(bucket_it);
     }
-    //Check if the minus-word is empty
-    else if (word.size() == 1 && word[0] == '-') {
-        throw std::invalid_argument("minus-word is empty"s);
+}
+
+
+void SearchServer::IndexDocumentPositions(int document_id, const std::vector<std::string_view>& words) {
+    // Stop words take their positions too, so that a phrase with a stop word matches only the same gap
+    const auto& document_words = document_id_to_words_freq_.at(document_id);
+    std::map<std::string_view, std::vector<uint32_t>> word_to_positions;
+    uint32_t position = 0;
+    for (const std::string_view word : words) {
+        if (!IsStopWord(word)) {
+            word_to_positions[document_words.find(word)->first].push_back(position);
+        }
+        ++position;
     }
+    positional_index_->AddDocument(document_id, { word_to_positions.begin(), word_to_positions.end() });
 }
 
 
-bool SearchServer::IsValidWord(const std::string & word) {
+bool SearchServer::IsValidWord(std::string_view word) {
     // A valid word must not contain special characters
-    return none_of(word.begin(), word.end(), [](char c) {
+    return std::none_of(word.begin(), word.end(), [](char c) {
         return c >= '\0' && c < ' ';
         });
 }
 
 
-bool SearchServer::IsStopWord(const std::string & word) const {
-    return stop_words_.count(word) > 0;
+bool SearchServer::IsWildcardWord(std::string_view word) const {
+    return is_wildcard_matching_enabled_ && word.find(WILDCARD) != std::string_view::npos;
 }
 
 
-std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string & text) const {
-    using namespace std::string_literals;
-    std::vector<std::string> words;
-    for (const std::string& word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("Word "s + word + " is invalid"s);
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+bool SearchServer::MatchesWildcard(std::string_view pattern, std::string_view word) {
+    // Greedy matching with backtracking to the last wildcard
+    size_t pattern_pos = 0;
+    size_t word_pos = 0;
+    size_t last_wildcard_pos = std::string_view::npos;
+    size_t last_wildcard_word_pos = 0;
+    while (word_pos < word.size()) {
+        if (pattern_pos < pattern.size() && pattern[pattern_pos] == WILDCARD) {
+            last_wildcard_pos = pattern_pos++;
+            last_wildcard_word_pos = word_pos;
+        } else if (pattern_pos < pattern.size() && pattern[pattern_pos] == word[word_pos]) {
+            ++pattern_pos;
+            ++word_pos;
+        } else if (last_wildcard_pos != std::string_view::npos) {
+            pattern_pos = last_wildcard_pos + 1;
+            word_pos = ++last_wildcard_word_pos;
+        } else {
+            return false;
         }
     }
+    while (pattern_pos < pattern.size() && pattern[pattern_pos] == WILDCARD) {
+        ++pattern_pos;
+    }
+    return pattern_pos == pattern.size();
+}
+
+
+bool SearchServer::IsStopWord(std::string_view word) const {
+    return stop_words_.count(word) > 0;
+}
+
+
+std::vector<std::string_view> SearchServer::AnalyzeText(std::string_view text, std::string & buffer) const {
+    TRACE_SPAN("SplitIntoWords");
+    std::vector<std::string_view> words;
+    if (text_analyzer_) {
+        buffer.assign(text);
+        text_analyzer_->Analyze(buffer.data(), buffer.size(), words);
+    } else {
+        SplitIntoValidWordViews(text, words);
+    }
     return words;
 }
 
@@ -214,41 +692,849 @@ int SearchServer::ComputeAverageRating(const std::vector<int>&ratings) {
 }
 
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string text) const {
-    using namespace std::string_literals;
-    if (text.empty()) {
-        throw std::invalid_argument("Query word is empty"s);
+// Parses a query in one pass. A clause is a word, a phrase or a group in parentheses; an operator joins two clauses.
+// A required word or phrase makes every its word required, a required group any of its words.
+class SearchServer::QueryParser {
+public:
+    QueryParser(const SearchServer& search_server, std::string_view text)
+        : search_server_(search_server)
+        , text_(text)
+        , has_phrases_(search_server.positional_index_ != nullptr)
+    {
+        // A group can be closed only by a word ending with ')', so a '(' after the last such word
+        // is an ordinary character
+        size_t position = text_.rfind(')');
+        while (position != std::string_view::npos && position + 1 < text_.size() && text_[position + 1] != ' ') {
+            position = position == 0 ? std::string_view::npos : text_.rfind(')', position - 1);
+        }
+        group_end_limit_ = position == std::string_view::npos ? 0 : position + 1;
+        // The analyzer normalizes every word in place in a copy of the text; a word may become several words
+        if (search_server_.text_analyzer_) {
+            analyzed_text_ = std::make_shared<std::string>(text_);
+        }
     }
-    std::string word = text;
-    bool is_minus = false;
-    if (word[0] == '-') {
-        is_minus = true;
-        word = word.substr(1);
+
+
+    Query Parse() {
+        using namespace std::string_literals;
+        ForEachWord(text_, [this](std::string_view word) {
+            ParseWord(word);
+            });
+        if (is_in_phrase_) {
+            throw std::invalid_argument("phrase is not closed"s);
+        }
+        if (!pending_operator_.empty()) {
+            AddPendingOperatorAsWord();
+        }
+
+        AddRequiredGroups();
+        for (auto* words : { &result_.plus_words, &result_.minus_words }) {
+            std::sort(words->begin(), words->end());
+            words->resize(std::unique(words->begin(), words->end()) - words->begin());
+        }
+        result_.analyzed_text = std::move(analyzed_text_);
+        return std::move(result_);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
-        throw std::invalid_argument("Query word "s + text + " is invalid");
+
+private:
+    struct Clause {
+        size_t words_begin;
+        size_t words_end;
+        bool is_group;
+        bool is_minus;
+        bool is_required;
+    };
+
+
+    static bool IsOperator(std::string_view word) {
+        using namespace std::literals;
+        return word == "AND"sv || word == "OR"sv;
     }
 
-    return { word, is_minus, IsStopWord(word) };
-}
 
+    void ParseWord(std::string_view word) {
+        using namespace std::string_literals;
+        if (!is_in_phrase_ && IsOperator(word) && ParseOperator(word)) {
+            return;
+        }
+
+        std::string_view query_word = word;
+        bool is_required = false;
+        if (!is_in_phrase_ && !is_in_group_ && query_word[0] == '+') {
+            if (query_word.size() == 1) {
+                throw std::invalid_argument("required word is empty"s);
+            }
+            if (query_word[1] == '+' || query_word[1] == '-') {
+                throw std::invalid_argument("too many operators in the word "s + std::string(word));
+            }
+            is_required = true;
+            query_word.remove_prefix(1);
+        }
+        bool closes_group = false;
+        if (!is_in_phrase_) {
+            const bool is_minus_group = !is_required && query_word.size() > 1 && query_word[0] == '-' && query_word[1] == '(';
+            const bool can_be_closed = static_cast<size_t>(word.data() + word.size() - text_.data()) <= group_end_limit_;
+            if ((query_word[0] == '(' || is_minus_group) && can_be_closed) {
+                if (is_in_group_) {
+                    throw std::invalid_argument("group is opened inside another group by the word "s + std::string(word));
+                }
+                OpenGroup(is_minus_group, is_required);
+                query_word.remove_prefix(is_minus_group ? 2 : 1);
+                if (query_word.empty()) {
+                    return;
+                }
+            }
+            // Outside a group a closing parenthesis is an ordinary character
+            if (is_in_group_ && query_word.back() == ')') {
+                closes_group = true;
+                query_word.remove_suffix(1);
+                if (query_word.empty()) {
+                    CloseGroup();
+                    return;
+                }
+            }
+        }
+        const bool is_quoted = has_phrases_ && (query_word[0] == '"' || query_word.back() == '"');
+        if (is_in_group_ && (is_quoted || query_word[0] == '-' || query_word[0] == '+')) {
+            throw std::invalid_argument("word "s + std::string(word) + " is inside a group"s);
+        }
+
+        if (has_phrases_ && query_word.front() == '"' && !is_in_phrase_) {
+            OpenPhrase(is_required);
+            query_word.remove_prefix(1);
+        } else if (has_phrases_ && query_word.front() == '"' && query_word.size() > 1) {
+            throw std::invalid_argument("phrase is opened inside another phrase by the word "s + std::string(word));
+        }
+        bool closes_phrase = false;
+        if (has_phrases_ && !query_word.empty() && query_word.back() == '"') {
+            if (!is_in_phrase_) {
+                throw std::invalid_argument("phrase is closed by the word "s + std::string(word) + " but never opened"s);
+            }
+            closes_phrase = true;
+            query_word.remove_suffix(1);
+        }
+        if (query_word.empty()) {
+            // A lone quote
+            if (closes_phrase) {
+                ClosePhrase();
+            }
+            return;
+        }
+        bool is_minus = false;
+        if (query_word[0] == '-') {
+            if (query_word.size() == 1) {
+                throw std::invalid_argument("minus-word is empty"s);
+            }
+            if (query_word[1] == '-') {
+                throw std::invalid_argument("too much minuses in the minus-word "s + std::string(word));
+            }
+            if (is_in_phrase_) {
+                throw std::invalid_argument("minus-word "s + std::string(word) + " is inside a phrase"s);
+            }
+            is_minus = true;
+            query_word.remove_prefix(1);
+        }
+        if (is_in_phrase_ && query_word[0] == '+') {
+            throw std::invalid_argument("required word "s + std::string(word) + " is inside a phrase"s);
+        }
+
+        AddWords(query_word, word, is_minus, is_required);
+        if (closes_phrase) {
+            ClosePhrase();
+        } else if (closes_group) {
+            CloseGroup();
+        } else if (!is_in_phrase_ && !is_in_group_) {
+            FinishClause();
+        }
+    }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string & text) const {
-    Query result;
-    for (const std::string& word : SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.insert(query_word.data);
+
+    // Returns false if the word is not in the position of an operator and so is an ordinary word:
+    // it has no left operand, follows another operator or is AND inside a group. An operator
+    // without a right operand becomes an ordinary word later.
+    bool ParseOperator(std::string_view word) {
+        using namespace std::literals;
+        const bool has_left_operand = is_in_group_ ? group_word_count_ > 0 : !clauses_.empty();
+        if (!has_left_operand || !pending_operator_.empty() || (is_in_group_ && word == "AND"sv)) {
+            return false;
+        }
+        pending_operator_ = word;
+        return true;
+    }
+
+
+    void AddPendingOperatorAsWord() {
+        const std::string_view word = pending_operator_;
+        pending_operator_ = {};
+        AddWords(word, word, false, false);
+        if (!is_in_group_) {
+            FinishClause();
+        }
+    }
+
+
+    void BeginClause(bool is_group, bool is_minus, bool is_required) {
+        using namespace std::literals;
+        // AND makes both operands required; a minus clause stays excluded
+        if (pending_operator_ == "AND"sv) {
+            if (!clauses_.back().is_minus) {
+                clauses_.back().is_required = true;
+            }
+            is_required = is_required || !is_minus;
+        }
+        pending_operator_ = {};
+        is_in_clause_ = true;
+        clauses_.push_back({ clause_words_.size(), clause_words_.size(), is_group, is_minus, is_required });
+    }
+
+
+    void FinishClause() {
+        is_in_clause_ = false;
+        clauses_.back().words_end = clause_words_.size();
+    }
+
+
+    void OpenGroup(bool is_minus, bool is_required) {
+        BeginClause(true, is_minus, is_required);
+        is_in_group_ = true;
+        group_word_count_ = 0;
+    }
+
+
+    void CloseGroup() {
+        using namespace std::string_literals;
+        if (!pending_operator_.empty()) {
+            AddPendingOperatorAsWord();
+        }
+        if (group_word_count_ == 0) {
+            throw std::invalid_argument("group is empty"s);
+        }
+        is_in_group_ = false;
+        FinishClause();
+    }
+
+
+    void OpenPhrase(bool is_required) {
+        BeginClause(false, false, is_required);
+        is_in_phrase_ = true;
+        phrase_begin_ = result_.phrase_words.size();
+        phrase_position_ = 0;
+    }
+
+
+    // A phrase of one word is an ordinary word; the offsets of a longer one start from 0
+    void ClosePhrase() {
+        is_in_phrase_ = false;
+        auto& phrase_words = result_.phrase_words;
+        if (phrase_words.size() - phrase_begin_ < 2) {
+            phrase_words.resize(phrase_begin_);
+        } else {
+            const uint32_t first_offset = phrase_words[phrase_begin_].offset;
+            for (size_t i = phrase_begin_; i < phrase_words.size(); ++i) {
+                phrase_words[i].offset -= first_offset;
+            }
+        }
+        FinishClause();
+    }
+
+
+    // Adds the words of the query word stripped of the operators to the current clause or to a new one
+    void AddWords(std::string_view query_word, std::string_view word, bool is_minus, bool is_required) {
+        using namespace std::string_literals;
+        analyzed_words_.clear();
+        if (search_server_.text_analyzer_) {
+            const bool is_wildcard_matching_enabled = search_server_.is_wildcard_matching_enabled_;
+            char* const analyzed_word = analyzed_text_->data() + (query_word.data() - text_.data());
+            const std::string_view extra_word_characters = is_wildcard_matching_enabled ? std::string_view(&WILDCARD, 1) : std::string_view();
+            search_server_.text_analyzer_->Analyze(analyzed_word, query_word.size(), analyzed_words_, extra_word_characters);
+        } else if (!IsValidWord(query_word)) {
+            throw std::invalid_argument("word "s + std::string(word) + " is not valid"s);
+        } else {
+            analyzed_words_.push_back(query_word);
+        }
+        if (!is_in_clause_) {
+            BeginClause(false, is_minus, is_required);
+        }
+        if (is_in_group_) {
+            ++group_word_count_;
+            pending_operator_ = {};
+            is_minus = clauses_.back().is_minus;
+        }
+        for (const std::string_view analyzed_word : analyzed_words_) {
+            if (search_server_.IsWildcardWord(analyzed_word) && (analyzed_word[0] == WILDCARD || is_in_phrase_)) {
+                throw std::invalid_argument("wildcard word "s + std::string(word) + " starts with a wildcard or is inside a phrase"s);
+            }
+            const bool is_stop_word = search_server_.IsStopWord(analyzed_word);
+            if (is_in_phrase_ && !is_stop_word) {
+                result_.phrase_words.push_back({ analyzed_word, phrase_position_ });
+            }
+            ++phrase_position_;
+            if (!is_stop_word) {
+                if (is_minus) {
+                    result_.minus_words.push_back(analyzed_word);
+                } else {
+                    result_.plus_words.push_back(analyzed_word);
+                    clause_words_.push_back(analyzed_word);
+                }
+            }
+        }
+    }
+
+
+    // Every required group is sorted, and the groups are sorted without duplicates
+    void AddRequiredGroups() {
+        std::vector<std::vector<std::string_view>> required_groups;
+        for (const Clause& clause : clauses_) {
+            if (!clause.is_required || clause.words_begin == clause.words_end) {
+                continue;
+            }
+            if (clause.is_group) {
+                auto& group = required_groups.emplace_back(clause_words_.begin() + clause.words_begin, clause_words_.begin() + clause.words_end);
+                std::sort(group.begin(), group.end());
+                group.erase(std::unique(group.begin(), group.end()), group.end());
             } else {
-                result.plus_words.insert(query_word.data);
+                for (size_t i = clause.words_begin; i < clause.words_end; ++i) {
+                    required_groups.push_back({ clause_words_[i] });
+                }
             }
         }
+        std::sort(required_groups.begin(), required_groups.end());
+        required_groups.erase(std::unique(required_groups.begin(), required_groups.end()), required_groups.end());
+        for (const auto& group : required_groups) {
+            result_.required_words.insert(result_.required_words.end(), group.begin(), group.end());
+            result_.required_group_ends.push_back(static_cast<uint32_t>(result_.required_words.size()));
+        }
+    }
+
+
+    const SearchServer& search_server_;
+    std::string_view text_;
+    std::shared_ptr<std::string> analyzed_text_;
+    Query result_;
+    std::vector<std::string_view> analyzed_words_;
+
+    std::vector<Clause> clauses_;
+    // The plus words of the clauses
+    std::vector<std::string_view> clause_words_;
+    bool is_in_clause_ = false;
+    // An operator waiting for its right operand
+    std::string_view pending_operator_;
+
+    // A phrase is quoted: its first word starts with '"' and its last word ends with '"'.
+    // Without the positional index quotes are ordinary characters.
+    const bool has_phrases_;
+    bool is_in_phrase_ = false;
+    size_t phrase_begin_ = 0;
+    uint32_t phrase_position_ = 0;
+
+    bool is_in_group_ = false;
+    size_t group_word_count_ = 0;
+    // The end of the last word ending with ')'
+    size_t group_end_limit_ = 0;
+};
+
+
+SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
+    TRACE_SPAN("ParseQuery");
+    return QueryParser(*this, text).Parse();
+}
+
+
+CorpusStatistics SearchServer::GetCorpusStatistics() const {
+    CorpusStatistics corpus;
+    corpus.document_count = documents_.size();
+    if (total_word_count_ > 0) {
+        corpus.inverse_average_document_length = static_cast<double>(documents_.size()) / total_word_count_;
+    }
+    return corpus;
+}
+
+
+SearchServer::ResolvedQuery SearchServer::ResolveQuery(const Query & query, std::pmr::memory_resource * resource) const {
+    TRACE_SPAN("ResolveQuery");
+    ResolvedQuery result(resource);
+    for (const std::string_view word : query.plus_words) {
+        if (IsWildcardWord(word)) {
+            ResolveWildcardWord(word, false, result);
+            continue;
+        }
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end()) {
+            result.plus_terms.push_back({ it->first, &it->second });
+        }
+    }
+    for (const std::string_view word : query.minus_words) {
+        if (IsWildcardWord(word)) {
+            ResolveWildcardWord(word, true, result);
+            continue;
+        }
+        const auto it = word_to_document_freqs_.find(word);
+        if (it != word_to_document_freqs_.end()) {
+            result.minus_terms.push_back(&it->second);
+        }
     }
+    ResolveFuzzyWords(query, result);
+    ResolvePositions(query, result);
+    ResolveRequirements(query, result);
     return result;
 }
 
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string & word) const {
-    return log(static_cast<double>(GetDocumentCount()) / word_to_document_freqs_.at(word).size());
+std::vector<const SearchServer::IndexEntry*> SearchServer::FindWildcardEntries(std::string_view word) const {
+    std::vector<const IndexEntry*> entries;
+    ForEachMatchingEntry(word_to_document_freqs_, word, [&entries](const IndexEntry& entry) {
+        // The keys of the removed words stay in the index with empty postings
+        if (!entry.second.empty()) {
+            entries.push_back(&entry);
+        }
+        });
+    if (entries.size() > wildcard_expansion_limit_) {
+        std::stable_sort(entries.begin(), entries.end(), [](const IndexEntry* lhs, const IndexEntry* rhs) {
+            return lhs->second.size() > rhs->second.size();
+            });
+        entries.resize(wildcard_expansion_limit_);
+        std::sort(entries.begin(), entries.end(), [](const IndexEntry* lhs, const IndexEntry* rhs) {
+            return lhs->first < rhs->first;
+            });
+    }
+    return entries;
+}
+
+
+void SearchServer::ResolveWildcardWord(std::string_view word, bool is_minus_word, ResolvedQuery & result) const {
+    const auto entries = FindWildcardEntries(word);
+    if (is_minus_word) {
+        for (const IndexEntry* entry : entries) {
+            result.minus_terms.push_back(&entry->second);
+        }
+        return;
+    }
+    if (entries.size() <= 1) {
+        if (!entries.empty()) {
+            result.plus_terms.push_back({ entries[0]->first, &entries[0]->second });
+        }
+        return;
+    }
+
+    // The postings are merged by document id with a heap of cursors, so every document gets
+    // one posting with the sum of the frequencies of the expanded words
+    using Cursor = std::pair<std::map<int, double>::const_iterator, std::map<int, double>::const_iterator>;
+    std::vector<Cursor> cursors;
+    cursors.reserve(entries.size());
+    QueryTerm term{ word, nullptr, static_cast<uint32_t>(result.expanded_words.size()), 0 };
+    for (const IndexEntry* entry : entries) {
+        cursors.emplace_back(entry->second.begin(), entry->second.end());
+        result.expanded_words.push_back(entry->first);
+    }
+    term.expanded_words_end = static_cast<uint32_t>(result.expanded_words.size());
+
+    const auto is_later = [](const Cursor& lhs, const Cursor& rhs) {
+        return lhs.first->first > rhs.first->first;
+    };
+    std::make_heap(cursors.begin(), cursors.end(), is_later);
+    std::map<int, double>& merged_postings = result.merged_postings.emplace_back();
+    while (!cursors.empty()) {
+        std::pop_heap(cursors.begin(), cursors.end(), is_later);
+        Cursor& cursor = cursors.back();
+        const auto [document_id, term_freq] = *cursor.first;
+        if (!merged_postings.empty() && std::prev(merged_postings.end())->first == document_id) {
+            std::prev(merged_postings.end())->second += term_freq;
+        } else {
+            merged_postings.emplace_hint(merged_postings.end(), document_id, term_freq);
+        }
+        if (++cursor.first == cursor.second) {
+            cursors.pop_back();
+        } else {
+            std::push_heap(cursors.begin(), cursors.end(), is_later);
+        }
+    }
+    term.document_freqs = &merged_postings;
+    result.plus_terms.push_back(term);
+}
+
+
+void SearchServer::ResolveRequirements(const Query & query, ResolvedQuery & result) const {
+    uint32_t group_begin = 0;
+    for (const uint32_t group_end : query.required_group_ends) {
+        const size_t postings_begin = result.required_postings.size();
+        for (uint32_t i = group_begin; i < group_end; ++i) {
+            const std::string_view word = query.required_words[i];
+            if (IsWildcardWord(word)) {
+                for (const IndexEntry* entry : FindWildcardEntries(word)) {
+                    result.required_postings.push_back(&entry->second);
+                }
+                continue;
+            }
+            const auto it = word_to_document_freqs_.find(word);
+            if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+                result.required_postings.push_back(&it->second);
+            }
+        }
+        if (result.required_postings.size() == postings_begin) {
+            result.has_unmatchable_requirement = true;
+        }
+        result.required_group_ends.push_back(static_cast<uint32_t>(result.required_postings.size()));
+        group_begin = group_end;
+    }
+}
+
+
+std::pmr::vector<int> SearchServer::FindRequiredCandidates(const ResolvedQuery & query, std::pmr::memory_resource * resource) const {
+    TRACE_SPAN("IntersectRequiredPostings");
+    std::pmr::vector<int> candidates(resource);
+    if (query.has_unmatchable_requirement) {
+        return candidates;
+    }
+
+    struct Group {
+        uint32_t begin;
+        uint32_t end;
+        // The total length of the postings
+        size_t cost;
+    };
+    std::pmr::vector<Group> groups(resource);
+    uint32_t group_begin = 0;
+    for (const uint32_t group_end : query.required_group_ends) {
+        size_t cost = 0;
+        for (uint32_t i = group_begin; i < group_end; ++i) {
+            cost += query.required_postings[i]->size();
+        }
+        groups.push_back({ group_begin, group_end, cost });
+        group_begin = group_end;
+    }
+    std::sort(groups.begin(), groups.end(), [](const Group& lhs, const Group& rhs) {
+        return lhs.cost < rhs.cost;
+        });
+
+    // The ids of a group are the sorted union of its postings
+    const auto collect_ids = [&query](const Group& group, std::pmr::vector<int>& ids) {
+        ids.clear();
+        ids.reserve(group.cost);
+        for (uint32_t i = group.begin; i < group.end; ++i) {
+            for (const auto& [document_id, _] : *query.required_postings[i]) {
+                ids.push_back(document_id);
+            }
+        }
+        if (group.end - group.begin > 1) {
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        }
+    };
+
+    collect_ids(groups.front(), candidates);
+    std::pmr::vector<int> group_ids(resource);
+    for (size_t i = 1; i < groups.size() && !candidates.empty(); ++i) {
+        const Group& group = groups[i];
+        if (group.cost > candidates.size() * REQUIRED_PROBE_RATIO) {
+            // Looking the candidates up skips the most of the long postings
+            const auto is_missing = [&query, &group](int document_id) {
+                for (uint32_t j = group.begin; j < group.end; ++j) {
+                    if (query.required_postings[j]->count(document_id)) {
+                        return false;
+                    }
+                }
+                return true;
+            };
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(), is_missing), candidates.end());
+        } else {
+            collect_ids(group, group_ids);
+            candidates.resize(IntersectSorted(candidates.data(), candidates.size(), group_ids.data(), group_ids.size(), candidates.data()));
+        }
+    }
+    return candidates;
+}
+
+
+bool SearchServer::SatisfiesRequirements(const ResolvedQuery & query, int document_id) {
+    if (query.has_unmatchable_requirement) {
+        return false;
+    }
+    uint32_t group_begin = 0;
+    for (const uint32_t group_end : query.required_group_ends) {
+        const bool has_word = std::any_of(query.required_postings.begin() + group_begin, query.required_postings.begin() + group_end, [document_id](const auto* document_freqs) {
+            return document_freqs->count(document_id) > 0;
+            });
+        if (!has_word) {
+            return false;
+        }
+        group_begin = group_end;
+    }
+    return true;
+}
+
+
+bool SearchServer::SatisfiesRequirements(const Query & query, const std::map<std::string_view, double>&document_words) const {
+    uint32_t group_begin = 0;
+    for (const uint32_t group_end : query.required_group_ends) {
+        bool has_word = false;
+        for (uint32_t i = group_begin; i < group_end && !has_word; ++i) {
+            ForEachMatchingEntry(document_words, query.required_words[i], [&has_word](const auto&) {
+                has_word = true;
+                });
+        }
+        if (!has_word) {
+            return false;
+        }
+        group_begin = group_end;
+    }
+    return true;
+}
+
+
+void SearchServer::ResolveFuzzyWords(const Query & query, ResolvedQuery & result) const {
+    if (fuzzy_max_edit_distance_ == 0) {
+        return;
+    }
+    TRACE_SPAN("ResolveFuzzyWords");
+    // Every indexed word gets the smallest of its distances to the plus words
+    std::map<std::string_view, std::pair<const IndexEntry*, int>> word_to_match;
+    std::shared_ptr<const TermDictionary> dictionary;
+    const auto add_matches = [this, &word_to_match, &dictionary](const LevenshteinAutomaton& automaton) {
+        for (const auto& [matched_word, distance] : dictionary->FindWithinDistance(automaton)) {
+            const IndexEntry& entry = *word_to_document_freqs_.find(matched_word);
+            if (distance == 0 || entry.second.empty()) {
+                continue;
+            }
+            const auto [it, is_new_word] = word_to_match.emplace(entry.first, std::pair{ &entry, distance });
+            if (!is_new_word) {
+                it->second.second = std::min(it->second.second, distance);
+            }
+        }
+    };
+    for (const std::string_view word : query.plus_words) {
+        const int max_edit_distance = std::min(fuzzy_max_edit_distance_, word.size() < 3 ? 0 : word.size() < 6 ? 1 : 2);
+        if (max_edit_distance == 0 || IsWildcardWord(word)) {
+            continue;
+        }
+        if (!dictionary) {
+            dictionary = GetTermDictionary();
+        }
+        add_matches(LevenshteinAutomaton(word, 1));
+        if (max_edit_distance > 1) {
+            // Beyond 1 edit the first characters must match, which prunes most of the dictionary
+            add_matches(LevenshteinAutomaton(word, max_edit_distance, FUZZY_PREFIX_LENGTH));
+        }
+    }
+
+    for (const QueryTerm& term : result.plus_terms) {
+        const auto [words_begin, words_end] = result.GetTermWords(term);
+        for (auto word = words_begin; word != words_end; ++word) {
+            word_to_match.erase(*word);
+        }
+    }
+    for (const auto& [word, match] : word_to_match) {
+        QueryTerm term{ match.first->first, &match.first->second };
+        term.edit_distance = match.second;
+        result.plus_terms.push_back(term);
+    }
+}
+
+
+std::shared_ptr<const TermDictionary> SearchServer::GetTermDictionary() const {
+    // The words are never erased from the index, so a dictionary of the same size has the same words
+    auto dictionary = std::atomic_load(&term_dictionary_);
+    if (!dictionary || dictionary->size() != word_to_document_freqs_.size()) {
+        auto new_dictionary = std::make_shared<TermDictionary>();
+        for (const auto& [word, _] : word_to_document_freqs_) {
+            new_dictionary->PushBack(word);
+        }
+        dictionary = std::move(new_dictionary);
+        std::atomic_store(&term_dictionary_, dictionary);
+    }
+    return dictionary;
+}
+
+
+double SearchServer::GetTermBoost(const QueryTerm & term) const {
+    return term.edit_distance > 0 ? pow(fuzzy_discount_, term.edit_distance) : 1.0;
+}
+
+
+void SearchServer::ResolvePositions(const Query & query, ResolvedQuery & result) const {
+    if (!positional_index_) {
+        return;
+    }
+    for (const PhraseWord& phrase_word : query.phrase_words) {
+        const auto it = word_to_document_freqs_.find(phrase_word.word);
+        if (it == word_to_document_freqs_.end()) {
+            result.has_unmatchable_phrase = true;
+            break;
+        }
+        result.phrase_terms.push_back({ it->first, &it->second, phrase_word.offset });
+    }
+    result.uses_positions = !query.phrase_words.empty() || (proximity_weight_ > 0.0 && result.plus_terms.size() > 1);
+}
+
+
+double SearchServer::ComputePositionalFactor(const ResolvedQuery & query, int document_id) const {
+    if (query.has_unmatchable_phrase) {
+        return 0.0;
+    }
+    // The terms are checked first, so the positions are decoded only for the documents having every phrase word
+    const auto& phrase_terms = query.phrase_terms;
+    for (const PhraseTerm& term : phrase_terms) {
+        if (!term.document_freqs->count(document_id)) {
+            return 0.0;
+        }
+    }
+
+    std::vector<uint32_t> phrase_starts;
+    for (size_t phrase_begin = 0; phrase_begin < phrase_terms.size();) {
+        phrase_starts.clear();
+        auto positions = positional_index_->GetPositions(document_id, phrase_terms[phrase_begin].word);
+        for (uint32_t position; positions.Next(position);) {
+            phrase_starts.push_back(position);
+        }
+
+        // Every next word of the phrase leaves only the starts having the word at its offset
+        size_t phrase_end = phrase_begin + 1;
+        for (; phrase_end < phrase_terms.size() && phrase_terms[phrase_end].offset != 0; ++phrase_end) {
+            const PhraseTerm& term = phrase_terms[phrase_end];
+            positions = positional_index_->GetPositions(document_id, term.word);
+            uint32_t position = 0;
+            bool has_position = positions.Next(position);
+            size_t kept_count = 0;
+            for (const uint32_t start : phrase_starts) {
+                while (has_position && position < start + term.offset) {
+                    has_position = positions.Next(position);
+                }
+                if (has_position && position == start + term.offset) {
+                    phrase_starts[kept_count++] = start;
+                }
+            }
+            phrase_starts.resize(kept_count);
+            if (phrase_starts.empty()) {
+                return 0.0;
+            }
+        }
+        phrase_begin = phrase_end;
+    }
+
+    if (proximity_weight_ <= 0.0 || query.plus_terms.size() < 2) {
+        return 1.0;
+    }
+    // Positions of all the query words in the document tagged with the indexes of the words
+    std::vector<std::pair<uint32_t, size_t>> positions;
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        if (!query.plus_terms[i].document_freqs->count(document_id)) {
+            continue;
+        }
+        const auto [words_begin, words_end] = query.GetTermWords(query.plus_terms[i]);
+        for (auto word = words_begin; word != words_end; ++word) {
+            auto term_positions = positional_index_->GetPositions(document_id, *word);
+            for (uint32_t position; term_positions.Next(position);) {
+                positions.emplace_back(position, i);
+            }
+        }
+    }
+    std::sort(positions.begin(), positions.end());
+    uint32_t min_distance = std::numeric_limits<uint32_t>::max();
+    for (size_t i = 1; i < positions.size(); ++i) {
+        if (positions[i].second != positions[i - 1].second) {
+            min_distance = std::min(min_distance, positions[i].first - positions[i - 1].first);
+        }
+    }
+    return min_distance == std::numeric_limits<uint32_t>::max() ? 1.0 : 1.0 + proximity_weight_ / min_distance;
+}
+
+
+std::vector<Document> SearchServer::SelectTopDocuments(std::pmr::vector<Document>&documents) {
+    TRACE_SPAN("SelectTopDocuments");
+    sort(documents.begin(), documents.end(), IsMoreRelevant);
+    const size_t result_size = std::min<size_t>(documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    return { documents.begin(), documents.begin() + result_size };
+}
+
+
+std::string SearchServer::BuildCanonicalQuery(const Query & query) {
+    // Words never contain control characters, so they are safe to use as separators
+    std::string canonical_query;
+    for (const std::string_view word : query.plus_words) {
+        canonical_query += word;
+        canonical_query += '\x01';
+    }
+    canonical_query += '\x02';
+    for (const std::string_view word : query.minus_words) {
+        canonical_query += word;
+        canonical_query += '\x01';
+    }
+    canonical_query += '\x04';
+    for (const PhraseWord& phrase_word : query.phrase_words) {
+        canonical_query += phrase_word.word;
+        canonical_query += '\x01';
+        canonical_query += std::to_string(phrase_word.offset);
+        canonical_query += '\x01';
+    }
+    canonical_query += '\x05';
+    uint32_t group_begin = 0;
+    for (const uint32_t group_end : query.required_group_ends) {
+        for (uint32_t i = group_begin; i < group_end; ++i) {
+            canonical_query += query.required_words[i];
+            canonical_query += '\x01';
+        }
+        canonical_query += '\x02';
+        group_begin = group_end;
+    }
+    return canonical_query;
+}
+
+
+std::shared_ptr<const SearchServer::PreparedQuery::Resolution> SearchServer::GetResolution(const PreparedQuery & prepared_query) const {
+    using namespace std::string_literals;
+    if (prepared_query.search_server_ != this) {
+        throw std::invalid_argument("Query was prepared by another search server"s);
+    }
+    auto resolution = std::atomic_load(&prepared_query.resolution_);
+    if (resolution->generation != generation_) {
+        // The words of the query are parsed again from its text only if the parsing has changed
+        Query query = resolution->parse_generation == parse_generation_ ? resolution->parsed_query : ParseQuery(*prepared_query.text_);
+        ResolvedQuery resolved_query = ResolveQuery(query);
+        resolution = std::make_shared<const PreparedQuery::Resolution>(PreparedQuery::Resolution{ generation_, parse_generation_, std::move(query), std::move(resolved_query) });
+        std::atomic_store(&prepared_query.resolution_, resolution);
+    }
+    return resolution;
+}
+
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchResolvedQuery(const ResolvedQuery & query, int document_id) const {
+    TRACE_SPAN("MatchWords");
+    const DocumentStatus status = documents_.at(document_id).status;
+    for (const auto* document_freqs : query.minus_terms) {
+        if (document_freqs->count(document_id)) {
+            return { std::vector<std::string_view>(), status };
+        }
+    }
+    if (!SatisfiesRequirements(query, document_id)) {
+        return { std::vector<std::string_view>(), status };
+    }
+
+    std::vector<std::string_view> matched_words;
+    const auto& document_words = document_id_to_words_freq_.at(document_id);
+    for (const QueryTerm& term : query.plus_terms) {
+        if (term.edit_distance > 0 || !term.document_freqs->count(document_id)) {
+            continue;
+        }
+        const auto [words_begin, words_end] = query.GetTermWords(term);
+        for (auto word = words_begin; word != words_end; ++word) {
+            if (term.expanded_words_begin == term.expanded_words_end || document_words.count(*word)) {
+                matched_words.push_back(*word);
+            }
+        }
+    }
+    if (!query.expanded_words.empty()) {
+        std::sort(matched_words.begin(), matched_words.end());
+        matched_words.erase(std::unique(matched_words.begin(), matched_words.end()), matched_words.end());
+    }
+    return { std::move(matched_words), status };
+}
+
+
+bool SearchServer::IsMoreRelevant(const Document & lhs, const Document & rhs) {
+    const double lhs_bucket = GetRelevanceBucket(lhs.relevance, eps);
+    const double rhs_bucket = GetRelevanceBucket(rhs.relevance, eps);
+    if (lhs_bucket == rhs_bucket) {
+        return lhs.rating > rhs.rating;
+    } else {
+        return lhs_bucket > rhs_bucket;
+    }
 }
\ No newline at end of file
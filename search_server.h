@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <list>
 #include <string>
 #include <set>
 #include <map>
@@ -9,20 +10,53 @@
 #include <execution>
 #include <type_traits>
 #include <mutex>
+#include <numeric>
+#include <future>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
 
 #include "document.h"
 #include "log_duration.h"
+#include "profile.h"
+#include "trace.h"
+#include "workload_log.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
+#include "query_arena.h"
+#include "query_executor.h"
+#include "positional_index.h"
+#include "scorer.h"
+#include "term_dictionary.h"
+#include "text_analyzer.h"
+#include "result_cache.h"
+#include "small_vector.h"
 
 
 class SearchServer {
 public:
+    class PreparedQuery;
+
 
     inline static constexpr int CONCURRENT_MEP_THREADS_COUNT = 500;
     inline static constexpr int MAX_RESULT_DOCUMENT_COUNT = 5;
     inline static constexpr double eps = 1e-6;
     inline static constexpr int INVALID_DOCUMENT_ID = -1;
+    inline static constexpr char WILDCARD = '*';
+    inline static constexpr size_t DEFAULT_WILDCARD_EXPANSION_LIMIT = 64;
+    inline static constexpr double DEFAULT_FUZZY_DISCOUNT = 0.5;
+    // The number of the first characters that a fuzzy match within 2 edits must share with the query word
+    inline static constexpr size_t FUZZY_PREFIX_LENGTH = 1;
+
+
+    // What AddDocument does with a document whose set of words equals the set of an indexed document
+    enum class DuplicatePolicy {
+        ALLOW,
+        // The document is not indexed, but is listed in GetSkippedDuplicates
+        REPORT,
+        // AddDocument throws std::invalid_argument
+        REJECT
+    };
 
 
     template <typename StringContainer>
@@ -48,21 +82,218 @@ public:
     void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
 
 
+    void SetDuplicatePolicy(DuplicatePolicy policy);
+
+
+    DuplicatePolicy GetDuplicatePolicy() const;
+
+
+    // Ids of the documents skipped under DuplicatePolicy::REPORT mapped to the ids of the documents they duplicate
+    const std::map<int, int>& GetSkippedDuplicates() const;
+
+
+    // Records the current stop words and then every change of the index; the request queues record
+    // their find requests to the same recorder. nullptr stops the recording.
+    void SetWorkloadRecorder(std::shared_ptr<WorkloadRecorder> recorder);
+
+
+    WorkloadRecorder* GetWorkloadRecorder() const;
+
+
+    // Starts keeping the positions of the words, so that quoted phrases of a query ("curly hair")
+    // match only documents containing the words next to each other. With a positive proximity weight
+    // the relevance of a document is multiplied by 1 + weight / (the shortest distance between two
+    // different query words). MatchDocument ignores the order of the phrase words. Without the index
+    // quotes are ordinary characters of the words, as in the documents.
+    // Throws std::logic_error if the server already has documents.
+    void EnablePositionalIndex(double proximity_weight = 0.0);
+
+
+    bool IsPositionalIndexEnabled() const;
+
+
+    // Approximate size of the positional index in bytes, 0 if it is disabled
+    size_t GetPositionalIndexMemoryUsage() const;
+
+
+    // Once enabled, a query word with WILDCARD matches the indexed words where WILDCARD stands for any
+    // sequence of characters ("pig*" matches "pig" and "piglet"); the word must not start with WILDCARD.
+    // Disabled by default: WILDCARD is then an ordinary character, so indexed words containing it
+    // are matched literally.
+    void EnableWildcardMatching();
+
+
+    void DisableWildcardMatching();
+
+
+    bool IsWildcardMatchingEnabled() const;
+
+
+    // A wildcard word is expanded to at most limit of its most frequent words, and the postings
+    // of a plus word are merged into one term. Throws std::invalid_argument if the limit is 0.
+    void SetWildcardExpansionLimit(size_t limit);
+
+
+    size_t GetWildcardExpansionLimit() const;
+
+
+    // Plus words also match the indexed words within max_edit_distance (1 or 2) Levenshtein edits,
+    // and the relevance of such a match is multiplied by discount for every edit. Words shorter than
+    // 3 characters are matched exactly and words shorter than 6 characters within 1 edit. A match within
+    // 2 edits must start with the first FUZZY_PREFIX_LENGTH characters of the word, which keeps the search
+    // of a word in a million-word vocabulary under a millisecond.
+    // The Match* methods report only the exact matches. The first fuzzy query after new words are
+    // indexed builds a sorted dictionary of the words in O(number of words).
+    void EnableFuzzyMatching(int max_edit_distance = 1, double discount = DEFAULT_FUZZY_DISCOUNT);
+
+
+    void DisableFuzzyMatching();
+
+
+    // 0 if fuzzy matching is disabled
+    int GetFuzzyMaxEditDistance() const;
+
+
+    // Documents, queries and stop words are split into words and normalized by the analyzer, so that
+    // "Cat," in a document matches the query word "cat"; the texts must be valid UTF-8. Query operators
+    // are recognized before the words are analyzed. Without the analyzer the words are separated by
+    // spaces and taken as they are. Throws std::logic_error if the server already has documents.
+    void EnableTextAnalyzer(const AnalyzerOptions& options = AnalyzerOptions());
+
+
+    bool IsTextAnalyzerEnabled() const;
+
+
+    // A query word prefixed with '+' is required: only the documents containing it match. AND makes
+    // both of its operands required, OR only separates them. Words in parentheses form a group:
+    // "+(cat OR dog)" requires any of the words, "-(cat dog)" excludes all of them. Groups can't
+    // be nested and their words can't be quoted or have operators other than OR. AND and OR without
+    // an operand on either side and AND inside a group are ordinary words; outside a group ')' is an
+    // ordinary character, and so is a '(' that no later word closes.
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate) const {
-        using namespace std::literals;
-        CheckQuery(raw_query.data());
-        LOG_DURATION("FindTopDocuments operation time"s);
-
-        const auto query = ParseQuery(raw_query.data());
-        auto matched_documents = FindAllDocuments(query, document_predicate);
-        sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < eps) {
-                return lhs.rating > rhs.rating;
-            } else {
-                return lhs.relevance > rhs.relevance;
-            }
+        return FindTopDocumentsScored(TfIdfScorer(), raw_query, document_predicate);
+    }
+
+
+    // FindTopDocuments ranking the documents by the scorer policy (see scorer.h)
+    template <typename Scorer, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsScored(const Scorer& scorer, const std::string_view& raw_query, DocumentPredicate document_predicate) const {
+        PROFILE_SCOPE("FindTopDocuments");
+        TRACE_OPERATION("FindTopDocuments");
+        QueryArena::Scope arena;
+
+        const auto query = ParseQuery(raw_query);
+        auto matched_documents = FindAllDocuments(ResolveQuery(query, arena.GetResource()), document_predicate, arena.GetResource(), scorer);
+
+        return SelectTopDocuments(matched_documents);
+    }
+
+
+    template <typename Scorer>
+    std::vector<Document> FindTopDocumentsScored(const Scorer& scorer, const std::string_view& raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const {
+        return FindTopDocumentsScored(scorer, raw_query, [status]([[maybe_unused]] int document_id, [[maybe_unused]] DocumentStatus document_status, [[maybe_unused]] int rating) {
+            return document_status == status;
             });
+    }
+
+
+    // Returns up to page_size documents that follow the cursor in the order of FindTopDocuments
+    // (ties broken by id) and the cursor of the next page. Only page_size documents are kept
+    // in a heap, so a deep page costs O(matches * log(page_size)).
+    template <typename DocumentPredicate>
+    SearchPage FindTopDocumentsPage(const std::string_view& raw_query, const SearchCursor& cursor, size_t page_size, DocumentPredicate document_predicate) const {
+        using namespace std::string_literals;
+        if (page_size == 0) {
+            throw std::invalid_argument("Page size must be positive"s);
+        }
+        QueryArena::Scope arena;
+
+        const auto query = ParseQuery(raw_query);
+        const auto matched_documents = FindAllDocuments(ResolveQuery(query, arena.GetResource()), document_predicate, arena.GetResource());
+
+        // The heap keeps the page with its last document on top
+        const auto is_before = [](const Document& lhs, const Document& rhs) {
+            return SearchCursor::IsBefore(lhs, rhs, eps);
+        };
+        SearchPage page;
+        page.documents.reserve(std::min(page_size, matched_documents.size()));
+        size_t following_count = 0;
+        for (const Document& document : matched_documents) {
+            if (!cursor.IsBefore(document, eps)) {
+                continue;
+            }
+            ++following_count;
+            if (page.documents.size() < page_size) {
+                page.documents.push_back(document);
+                std::push_heap(page.documents.begin(), page.documents.end(), is_before);
+            } else if (is_before(document, page.documents.front())) {
+                std::pop_heap(page.documents.begin(), page.documents.end(), is_before);
+                page.documents.back() = document;
+                std::push_heap(page.documents.begin(), page.documents.end(), is_before);
+            }
+        }
+        std::sort_heap(page.documents.begin(), page.documents.end(), is_before);
+
+        if (following_count > page_size) {
+            page.next_cursor = SearchCursor(page.documents.back());
+        }
+        return page;
+    }
+
+
+    SearchPage FindTopDocumentsPage(const std::string_view& raw_query, const SearchCursor& cursor, size_t page_size, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+
+    // Predicates can't be compared, so results filtered by a predicate are cached only
+    // under the key supplied by the caller. The key must identify the predicate.
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentPredicate document_predicate, const ResultCacheKey& cache_key) const {
+        using namespace std::literals;
+        if (!result_cache_) {
+            return FindTopDocuments(raw_query, document_predicate);
+        }
+        return FindTopDocumentsCached(raw_query, document_predicate, "p"s + cache_key.value);
+    }
+
+
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const;
+
+
+    std::vector<Document> FindTopDocuments(const std::string_view& raw_query) const;
+
+
+    // Validates and parses the query once so that it can be executed many times.
+    // Throws the same exceptions as FindTopDocuments does for an invalid query.
+    PreparedQuery PrepareQuery(const std::string_view& raw_query) const;
+
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const PreparedQuery& prepared_query, DocumentPredicate document_predicate) const {
+        TRACE_OPERATION("FindTopDocuments");
+        QueryArena::Scope arena;
+        const auto resolution = GetResolution(prepared_query);
+        auto matched_documents = FindAllDocuments(resolution->query, document_predicate, arena.GetResource());
+
+        return SelectTopDocuments(matched_documents);
+    }
+
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery& prepared_query, DocumentStatus status) const;
+
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery& prepared_query) const;
+
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const PreparedQuery& prepared_query, DocumentPredicate document_predicate) const {
+        if (!IsExecutionPolicyParallel(policy)) {
+            return FindTopDocuments(prepared_query, document_predicate);
+        }
+
+        const auto resolution = GetResolution(prepared_query);
+        auto matched_documents = FindAllDocuments(policy, resolution->query, document_predicate);
+        sort(std::execution::par, matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
         if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
             matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
         }
@@ -71,10 +302,22 @@ public:
     }
 
 
-    std::vector<Document> FindTopDocuments(const std::string_view& raw_query, DocumentStatus status) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const PreparedQuery& prepared_query, DocumentStatus status) const {
+        if (IsExecutionPolicyParallel(policy)) {
+            return FindTopDocuments(policy, prepared_query, [status]([[maybe_unused]] int document_id, [[maybe_unused]] DocumentStatus document_status, [[maybe_unused]] int rating) {
+                return document_status == status;
+                });
+        } else {
+            return FindTopDocuments(prepared_query, status);
+        }
+    }
 
 
-    std::vector<Document> FindTopDocuments(const std::string_view& raw_query) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const PreparedQuery& prepared_query) const {
+        return FindTopDocuments(policy, prepared_query, DocumentStatus::ACTUAL);
+    }
 
 
     template <typename ExecutionPolicy, typename DocumentPredicate>
@@ -84,18 +327,12 @@ public:
         }
 
         using namespace std::literals;
-        CheckQuery(raw_query.data());
-        LOG_DURATION("Parallel FindTopDocuments operation time"s);
-
-        const auto query = ParseQuery(raw_query.data());
-        auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-        sort(std::execution::par, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < eps) {
-                return lhs.rating > rhs.rating;
-            } else {
-                return lhs.relevance > rhs.relevance;
-            }
-            });
+        PROFILE_SCOPE("Parallel FindTopDocuments");
+        TRACE_OPERATION("Parallel FindTopDocuments");
+
+        const auto query = ParseQuery(raw_query);
+        auto matched_documents = FindAllDocuments(policy, ResolveQuery(query), document_predicate);
+        sort(std::execution::par, matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
         if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
             matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
         }
@@ -127,12 +364,56 @@ public:
     }
 
 
+    // Results of FindTopDocuments filtered by status (or by a predicate with a cache key) are
+    // cached until the index changes. memory_limit is the approximate size of the cache in bytes.
+    void EnableResultCache(size_t memory_limit, size_t shard_count = ResultCache::DEFAULT_SHARD_COUNT);
+
+
+    void DisableResultCache();
+
+
+    ResultCache::Stats GetResultCacheStats() const;
+
+
+    // Changes every time a document is added or removed
+    uint64_t GetGeneration() const;
+
+
+    // Starts the internal executor used by the Submit* methods
+    void StartQueryExecutor(size_t thread_count = 0, size_t queue_capacity = QueryExecutor::DEFAULT_QUEUE_CAPACITY,
+        QueryExecutor::OverflowPolicy overflow_policy = QueryExecutor::OverflowPolicy::BLOCK);
+
+
+    // Asynchronous FindTopDocuments: the query is executed by the internal executor.
+    // Throws std::logic_error if the executor is not started and std::runtime_error
+    // if the submission queue is full and the executor rejects new queries.
+    template <typename DocumentPredicate>
+    std::future<std::vector<Document>> SubmitFindTopDocuments(std::string raw_query, DocumentPredicate document_predicate) const {
+        return GetQueryExecutor().Submit([this, raw_query = std::move(raw_query), document_predicate]() {
+            return FindTopDocuments(raw_query, document_predicate);
+            });
+    }
+
+
+    std::future<std::vector<Document>> SubmitFindTopDocuments(std::string raw_query, DocumentStatus status) const;
+
+
+    std::future<std::vector<Document>> SubmitFindTopDocuments(std::string raw_query) const;
+
+
+    // Runs a batch of queries sharing the work between them: identical queries are executed
+    // once and every distinct term is looked up only once per batch.
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+
     int GetDocumentCount() const;
 
 
     void SetStopWords(const std::string& text);
 
 
+    // The matched words refer to the words stored in the index and stay valid as long as the server exists.
+    // Throws std::out_of_range if there is no document with such id.
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view& raw_query, int document_id) const;
 
 
@@ -142,52 +423,138 @@ public:
             return MatchDocument(raw_query, document_id);
         }
 
-        using namespace std::literals;
-        CheckQuery(raw_query.data());
-        if (!IsIDValid(document_ids_, document_id, true)) {
-            throw std::out_of_range("document's id is out of range");
+        TRACE_OPERATION("Parallel MatchDocument");
+        const auto query = ParseQuery(raw_query);
+        const auto& document_words = GetDocumentWords(document_id);
+        PROFILE_SCOPE("Parallel MatchDocument");
+        TRACE_SPAN("MatchWords");
+
+        const DocumentStatus status = documents_.at(document_id).status;
+        const bool has_minus_word = std::any_of(policy, query.minus_words.begin(), query.minus_words.end(), [this, &document_words](std::string_view word) {
+            bool has_word = false;
+            ForEachMatchingEntry(document_words, word, [&has_word](const auto&) {
+                has_word = true;
+                });
+            return has_word;
+            });
+        if (has_minus_word || !SatisfiesRequirements(query, document_words)) {
+            return { std::vector<std::string_view>(), status };
         }
-        LOG_DURATION("Parallel MathDocument operation time"s);
-
-        const auto query = ParseQuery(raw_query.data());
-        static std::vector<std::string> matched_words;
-        matched_words.clear();
 
-        for (const std::string& word : query.plus_words) {
-            if (!DoesMapContainSuchKey(word_to_document_freqs_, word)) {
-                continue;
+        // Empty views mark the words that the document doesn't contain and the wildcard words
+        std::vector<std::string_view> matched_words(query.plus_words.size());
+        std::transform(policy, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [this, &document_words](std::string_view word) {
+            if (IsWildcardWord(word)) {
+                return std::string_view();
             }
-            if (DoesMapContainSuchKey(word_to_document_freqs_.at(word), document_id)) {
-                matched_words.push_back(word);
+            const auto it = document_words.find(word);
+            return it == document_words.end() ? std::string_view() : it->first;
+            });
+        matched_words.erase(std::remove(matched_words.begin(), matched_words.end(), std::string_view()), matched_words.end());
+
+        bool has_wildcard_word = false;
+        for (const std::string_view word : query.plus_words) {
+            if (IsWildcardWord(word)) {
+                has_wildcard_word = true;
+                ForEachMatchingEntry(document_words, word, [&matched_words](const auto& entry) {
+                    matched_words.push_back(entry.first);
+                    });
             }
         }
-        for (const std::string& word : query.minus_words) {
-            if (!DoesMapContainSuchKey(word_to_document_freqs_, word)) {
+        if (has_wildcard_word) {
+            std::sort(matched_words.begin(), matched_words.end());
+            matched_words.erase(std::unique(matched_words.begin(), matched_words.end()), matched_words.end());
+        }
+
+        return { matched_words, status };
+    }
+
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const PreparedQuery& prepared_query, int document_id) const;
+
+
+    // Matches one query against many documents: the query is parsed once and the documents are
+    // processed by the policy. Throws std::out_of_range if any of the ids is unknown.
+    template <typename ExecutionPolicy>
+    MatchedDocuments MatchDocuments(ExecutionPolicy& policy, const std::string_view& raw_query, const std::vector<int>& document_ids) const {
+        QueryArena::Scope arena;
+        const auto query = ResolveQuery(ParseQuery(raw_query), arena.GetResource());
+
+        std::vector<const std::map<std::string_view, double>*> documents_words(document_ids.size());
+        std::transform(document_ids.begin(), document_ids.end(), documents_words.begin(), [this](int document_id) {
+            return &GetDocumentWords(document_id);
+            });
+
+        MatchedDocuments result;
+        result.statuses.resize(document_ids.size());
+        result.offsets.resize(document_ids.size() + 1);
+        // The words of a wildcard term are matched one by one
+        for (const QueryTerm& term : query.plus_terms) {
+            if (term.edit_distance > 0) {
                 continue;
             }
-            if (DoesMapContainSuchKey(word_to_document_freqs_.at(word), document_id)) {
-                matched_words.clear();
-                break;
-            }
+            const auto [words_begin, words_end] = query.GetTermWords(term);
+            result.terms.insert(result.terms.end(), words_begin, words_end);
+        }
+        if (!query.expanded_words.empty()) {
+            std::sort(result.terms.begin(), result.terms.end());
+            result.terms.erase(std::unique(result.terms.begin(), result.terms.end()), result.terms.end());
         }
 
-        static std::vector<std::string_view> matched_words_to_return;
-        matched_words_to_return.clear();
+        // The first pass marks the matched terms of every document and counts them
+        const size_t term_count = result.terms.size();
+        std::vector<char> is_matched(document_ids.size() * term_count);
+        std::vector<size_t> indexes(document_ids.size());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+            const auto& document_words = *documents_words[index];
+            result.statuses[index] = documents_.at(document_ids[index]).status;
+            const bool has_minus_word = std::any_of(query.minus_terms.begin(), query.minus_terms.end(), [&](const auto* document_freqs) {
+                return document_freqs->count(document_ids[index]) > 0;
+                });
+            if (has_minus_word || !SatisfiesRequirements(query, document_ids[index])) {
+                return;
+            }
+            size_t matched_count = 0;
+            for (size_t term = 0; term < term_count; ++term) {
+                if (document_words.count(result.terms[term])) {
+                    is_matched[index * term_count + term] = 1;
+                    ++matched_count;
+                }
+            }
+            result.offsets[index + 1] = matched_count;
+            });
 
-        for (size_t i = 0; i < matched_words.size(); ++i) {
-            matched_words_to_return.push_back(matched_words[i]);
-        }
+        // The second pass writes the term indexes at the offsets of the documents
+        std::partial_sum(result.offsets.begin(), result.offsets.end(), result.offsets.begin());
+        result.term_indexes.resize(result.offsets.back());
+        std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+            size_t offset = result.offsets[index];
+            for (size_t term = 0; term < term_count; ++term) {
+                if (is_matched[index * term_count + term]) {
+                    result.term_indexes[offset++] = static_cast<uint32_t>(term);
+                }
+            }
+            });
 
-        return { matched_words_to_return, documents_.at(document_id).status };
+        return result;
     }
 
 
-    const std::map<std::string, double>& GetWordFrequencies(int document_id) const;
+    MatchedDocuments MatchDocuments(const std::string_view& raw_query, const std::vector<int>& document_ids) const;
+
+
+    // The words refer to the words stored in the index
+    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
 
 
     void RemoveDocument(int document_id);
 
 
+    // Removes all the documents at once; unknown ids are ignored
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+
     template <typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy policy, int document_id) {
         if (!IsExecutionPolicyParallel(policy)) {
@@ -195,19 +562,29 @@ public:
             return;
         }
 
-        if (!IsIDValid(document_ids_, document_id, true)) {
+        const auto document_it = document_id_to_words_freq_.find(document_id);
+        if (document_id < 0 || document_it == document_id_to_words_freq_.end()) {
             return;
         }
 
-        for (auto& [_, documentIdToTF] : word_to_document_freqs_) {
-            if (documentIdToTF.count(document_id)) {
-                documentIdToTF.erase(document_id);
-            }
+        // Every word has its own posting map, so they can be updated concurrently
+        const auto& document_words = document_it->second;
+        std::for_each(std::execution::par, document_words.begin(), document_words.end(), [this, document_id](const auto& word_freq) {
+            word_to_document_freqs_.find(word_freq.first)->second.erase(document_id);
+            });
+        document_id_to_words_freq_.erase(document_it);
+        if (positional_index_) {
+            positional_index_->RemoveDocument(document_id);
         }
-        document_id_to_words_freq_.erase(document_id);
+        EraseDocumentFingerprint(document_id);
+        total_word_count_ -= documents_.at(document_id).word_count;
         documents_.erase(document_id);
         auto iter = find(std::execution::par, document_ids_.begin(), document_ids_.end(), document_id);
         document_ids_.erase(iter);
+        if (workload_recorder_) {
+            workload_recorder_->RecordRemoveDocument(document_id);
+        }
+        ++generation_;
     }
 
 
@@ -220,30 +597,183 @@ public:
     int GetDocumentId(int index) const;
 
 private:
+    inline static constexpr size_t QUERY_INLINE_WORD_COUNT = 8;
+    // A required group is probed document by document instead of being intersected
+    // when its postings are this many times longer than the candidates
+    inline static constexpr size_t REQUIRED_PROBE_RATIO = 8;
+
+
+    using IndexEntry = std::pair<const std::string, std::map<int, double>>;
+
+
+    struct PhraseWord {
+        std::string_view word;
+        // Position in the phrase; stop words are counted too
+        uint32_t offset;
+    };
+
+
+    // Sorted words without duplicates. The words refer to the text of the query or to analyzed_text.
+    // Outlives the query arena in PreparedQuery, so the words of a short query are kept inline instead.
     struct Query {
-        std::set<std::string> plus_words;
-        std::set<std::string> minus_words;
+        SmallVector<std::string_view, QUERY_INLINE_WORD_COUNT> plus_words;
+        SmallVector<std::string_view, QUERY_INLINE_WORD_COUNT> minus_words;
+        // Words of the phrases of two and more words in the order of the query, every phrase starts
+        // at offset 0. The phrase words are plus words as well.
+        std::vector<PhraseWord> phrase_words;
+        // Groups of plus words, a document must contain some word of every group. The group
+        // of a word is its index in required_group_ends, where the next group starts.
+        std::vector<std::string_view> required_words;
+        std::vector<uint32_t> required_group_ends;
+        // The copy of the text with the words normalized by the analyzer; shared by the copies of the query
+        std::shared_ptr<const std::string> analyzed_text;
     };
 
 
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
+    struct QueryTerm {
+        // Refers to the key of the index entry; a wildcard term refers to the query and stands
+        // for the expanded words from expanded_words_begin to expanded_words_end
+        std::string_view word;
+        const std::map<int, double>* document_freqs;
+        uint32_t expanded_words_begin = 0;
+        uint32_t expanded_words_end = 0;
+        // Positive for the fuzzy matches of the plus words
+        int edit_distance = 0;
+    };
+
+
+    struct PhraseTerm {
+        std::string_view word;  // refers to the key of the index entry
+        const std::map<int, double>* document_freqs;
+        uint32_t offset;
+    };
+
+
+    // Query with every word already looked up in the index; words missing from the index are dropped.
+    // The phrases are resolved only if the positional index is enabled.
+    struct ResolvedQuery {
+        explicit ResolvedQuery(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : plus_terms(resource)
+            , minus_terms(resource)
+            , phrase_terms(resource)
+            , expanded_words(resource)
+            , required_postings(resource)
+            , required_group_ends(resource)
+        {
+        }
+
+        // The terms refer to merged_postings, which must not be copied
+        ResolvedQuery(const ResolvedQuery&) = delete;
+        ResolvedQuery& operator=(const ResolvedQuery&) = delete;
+        ResolvedQuery(ResolvedQuery&&) = default;
+        ResolvedQuery& operator=(ResolvedQuery&&) = default;
+
+
+        // The indexed words that the term stands for
+        std::pair<const std::string_view*, const std::string_view*> GetTermWords(const QueryTerm& term) const {
+            if (term.expanded_words_begin == term.expanded_words_end) {
+                return { &term.word, &term.word + 1 };
+            }
+            return { expanded_words.data() + term.expanded_words_begin, expanded_words.data() + term.expanded_words_end };
+        }
+
+
+        std::pmr::vector<QueryTerm> plus_terms;
+        std::pmr::vector<const std::map<int, double>*> minus_terms;
+        std::pmr::vector<PhraseTerm> phrase_terms;
+        // Some phrase word is missing from the index, so no document matches
+        bool has_unmatchable_phrase = false;
+        // The matched documents must be checked by ComputePositionalFactor
+        bool uses_positions = false;
+        // Words of the wildcard plus terms
+        std::pmr::vector<std::string_view> expanded_words;
+        // Postings of the wildcard plus terms; a list, so that the terms can refer to them after a move
+        std::list<std::map<int, double>> merged_postings;
+        // Postings of the words of the required groups, grouped as in Query
+        std::pmr::vector<const std::map<int, double>*> required_postings;
+        std::pmr::vector<uint32_t> required_group_ends;
+        // Some required group has no indexed word, so no document matches
+        bool has_unmatchable_requirement = false;
+
+
+        bool HasRequirements() const {
+            return has_unmatchable_requirement || !required_group_ends.empty();
+        }
     };
 
+public:
+    // Query parsed by PrepareQuery and resolved against the index of the server that prepared it.
+    // On first use after the index or the settings change the words are resolved again; after
+    // a setting that changes parsing (the text analyzer, the positional index or wildcard matching)
+    // the query is parsed again from its text as well.
+    class PreparedQuery {
+    public:
+        PreparedQuery(const PreparedQuery& other);
+        PreparedQuery& operator=(const PreparedQuery& other);
+
+    private:
+        friend class SearchServer;
+
+        struct Resolution {
+            uint64_t generation;
+            uint64_t parse_generation;
+            Query parsed_query;
+            // Refers to the words of parsed_query, which stay in place when the resolution is moved
+            ResolvedQuery query;
+        };
+
+        PreparedQuery(const SearchServer& search_server, std::string_view raw_query);
+
+        const SearchServer* search_server_;
+        // Shared between the copies, so the words of the query stay valid
+        std::shared_ptr<const std::string> text_;
+        // Replaced atomically, so one prepared query may be executed from several threads
+        mutable std::shared_ptr<const Resolution> resolution_;
+    };
+
+private:
+
 
-    struct QueryWord {
-        std::string data;
-        bool is_minus;
-        bool is_stop;
+    struct DocumentData {
+        int rating;
+        DocumentStatus status;
+        uint64_t words_fingerprint;
+        // The number of words except the stop words
+        uint32_t word_count;
     };
 
 
-    std::set<std::string> stop_words_;
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string, double>> document_id_to_words_freq_ = { {-1, {} } };
+    std::set<std::string, std::less<>> stop_words_;
+    std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs_;
+    // Forward index; the words refer to the keys of word_to_document_freqs_, which are never erased
+    std::map<int, std::map<std::string_view, double>> document_id_to_words_freq_ = { {-1, {} } };
     std::map<int, DocumentData> documents_;
     std::vector<int> document_ids_;
+    // Sum of the word counts of the documents
+    uint64_t total_word_count_ = 0;
+    // Documents grouped by the fingerprints of their sets of words
+    std::unordered_map<uint64_t, std::vector<int>> fingerprint_to_document_ids_;
+    DuplicatePolicy duplicate_policy_ = DuplicatePolicy::ALLOW;
+    std::map<int, int> skipped_duplicates_;
+    std::shared_ptr<WorkloadRecorder> workload_recorder_;
+    // nullptr while the positional index is disabled
+    std::unique_ptr<PositionalIndex> positional_index_;
+    double proximity_weight_ = 0.0;
+    bool is_wildcard_matching_enabled_ = false;
+    size_t wildcard_expansion_limit_ = DEFAULT_WILDCARD_EXPANSION_LIMIT;
+    int fuzzy_max_edit_distance_ = 0;
+    double fuzzy_discount_ = DEFAULT_FUZZY_DISCOUNT;
+    // nullptr while the text analyzer is disabled
+    std::unique_ptr<TextAnalyzer> text_analyzer_;
+    // Sorted copy of the indexed words for fuzzy matching, rebuilt by the first fuzzy query after new
+    // words are indexed. Replaced atomically, so queries running concurrently may rebuild it.
+    mutable std::shared_ptr<const TermDictionary> term_dictionary_;
+    uint64_t generation_ = 0;
+    // Changed by the settings that change parsing, so that the prepared queries are parsed again
+    uint64_t parse_generation_ = 0;
+    std::unique_ptr<ResultCache> result_cache_;
+    // Declared last so that the workers are joined before the index is destroyed
+    std::unique_ptr<QueryExecutor> query_executor_;
 
 
     template <typename ExecutionPolicy>
@@ -255,73 +785,236 @@ private:
     }
 
 
-    template <typename Type, typename AnotherType>
-    static bool DoesMapContainSuchKey(std::map<Type, AnotherType> container, Type item) {
-        std::vector<Type> vector_of_keys(container.size());
-        for (auto [key, _] : container) {
-            vector_of_keys.push_back(key);
+    QueryExecutor& GetQueryExecutor() const;
+
+
+    // Throws std::out_of_range if there is no document with such id
+    const std::map<std::string_view, double>& GetDocumentWords(int document_id) const;
+
+
+    // Removes the document from the inverted and forward indexes and from the metadata, but not from document_ids_
+    void EraseDocumentFromIndex(int document_id);
+
+
+    // Returns INVALID_DOCUMENT_ID if no indexed document has exactly these sorted unique words
+    int FindDocumentWithWords(uint64_t words_fingerprint, const std::vector<std::string_view>& words) const;
+
+
+    // Must be called before the document is erased from documents_
+    void EraseDocumentFingerprint(int document_id);
+
+
+    // The document must already be in the inverted index; the words include the stop words
+    void IndexDocumentPositions(int document_id, const std::vector<std::string_view>& words);
+
+
+    static bool IsValidWord(std::string_view word);
+
+
+    // False for every word while wildcard matching is disabled
+    bool IsWildcardWord(std::string_view word) const;
+
+
+    // WILDCARD of the pattern matches any sequence of characters
+    static bool MatchesWildcard(std::string_view pattern, std::string_view word);
+
+
+    // Calls action for the entry of the word or for every entry matching the wildcard word.
+    // The map must be ordered by its string keys and support lookups by std::string_view.
+    template <typename WordMap, typename Action>
+    void ForEachMatchingEntry(WordMap& words, std::string_view query_word, Action action) const {
+        if (!IsWildcardWord(query_word)) {
+            const auto it = words.find(query_word);
+            if (it != words.end()) {
+                action(*it);
+            }
+            return;
+        }
+        // The matching words form the range of the words starting with the literal prefix
+        const std::string_view prefix = query_word.substr(0, query_word.find(WILDCARD));
+        for (auto it = words.lower_bound(prefix); it != words.end() && std::string_view(it->first).substr(0, prefix.size()) == prefix; ++it) {
+            if (MatchesWildcard(query_word, it->first)) {
+                action(*it);
+            }
         }
-        return std::count(std::execution::par, vector_of_keys.begin(), vector_of_keys.end(), item);
     }
 
 
-    static bool IsIDValid(std::vector<int> document_ids, int document_id, bool multithreading);
+    bool IsStopWord(std::string_view word) const;
 
 
-    static void CheckQuery(const std::string& query);
+    // All the words of the text including the stop words. The words normalized by the analyzer
+    // refer to buffer, the others to the text. Throws std::invalid_argument for an invalid word.
+    std::vector<std::string_view> AnalyzeText(std::string_view text, std::string& buffer) const;
 
 
-    static void AreMinusWordsCorrect(const std::string& word);
+    static int ComputeAverageRating(const std::vector<int>& ratings);
 
 
-    static bool IsValidWord(const std::string& word);
+    // Validates and parses a query in one pass
+    class QueryParser;
 
 
-    bool IsStopWord(const std::string& word) const;
+    Query ParseQuery(std::string_view text) const;
 
 
-    std::vector<std::string> SplitIntoWordsNoStop(const std::string& text) const;
+    CorpusStatistics GetCorpusStatistics() const;
 
 
-    static int ComputeAverageRating(const std::vector<int>& ratings);
+    ResolvedQuery ResolveQuery(const Query& query, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+
+    // The non-empty index entries matching the wildcard word, at most wildcard_expansion_limit_ of the most frequent
+    std::vector<const IndexEntry*> FindWildcardEntries(std::string_view word) const;
+
+
+    // Adds the terms of the expansion of the wildcard word
+    void ResolveWildcardWord(std::string_view word, bool is_minus_word, ResolvedQuery& result) const;
+
+
+    // A wildcard word of a required group stands for the words of its expansion; fuzzy matches don't count
+    void ResolveRequirements(const Query& query, ResolvedQuery& result) const;
+
+
+    // Sorted ids of the documents satisfying every required group, starting from the group with the
+    // shortest postings. Every other group costs either the total length of its postings, which are
+    // copied, sorted and intersected, or, if they are REQUIRED_PROBE_RATIO times longer than the
+    // candidates, O(candidates * log(length)) lookups. So only the probed groups are nearly free:
+    // two required words of similar frequency cost the sum of their postings.
+    std::pmr::vector<int> FindRequiredCandidates(const ResolvedQuery& query, std::pmr::memory_resource* resource) const;
+
+
+    static bool SatisfiesRequirements(const ResolvedQuery& query, int document_id);
+
+
+    bool SatisfiesRequirements(const Query& query, const std::map<std::string_view, double>& document_words) const;
+
+
+    // Adds the fuzzy matches of the plus words once the plus words are resolved
+    void ResolveFuzzyWords(const Query& query, ResolvedQuery& result) const;
+
+
+    std::shared_ptr<const TermDictionary> GetTermDictionary() const;
+
+
+    // The weight of the term relative to the weight given by the scorer
+    double GetTermBoost(const QueryTerm& term) const;
+
 
+    // Resolves the phrases of the query once its plus terms are resolved
+    void ResolvePositions(const Query& query, ResolvedQuery& result) const;
 
-    QueryWord ParseQueryWord(std::string text) const;
 
+    // 0 if the document doesn't contain every phrase of the query,
+    // otherwise the factor of its relevance given by the proximity of the query words
+    double ComputePositionalFactor(const ResolvedQuery& query, int document_id) const;
 
-    Query ParseQuery(const std::string& text) const;
 
+    std::shared_ptr<const PreparedQuery::Resolution> GetResolution(const PreparedQuery& prepared_query) const;
 
-    double ComputeWordInverseDocumentFreq(const std::string& word) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchResolvedQuery(const ResolvedQuery& query, int document_id) const;
+
+
+    static bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+
+    // Sorts the documents and copies the best of them into the result
+    static std::vector<Document> SelectTopDocuments(std::pmr::vector<Document>& documents);
+
+
+    static std::string BuildCanonicalQuery(const Query& query);
 
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-        std::map<int, double> document_to_relevance;
+    std::vector<Document> FindTopDocumentsCached(const std::string_view& raw_query, DocumentPredicate document_predicate, std::string_view filter_key) const {
+        PROFILE_SCOPE("FindTopDocuments");
+        TRACE_OPERATION("FindTopDocuments");
+        QueryArena::Scope arena;
+
+        const auto query = ParseQuery(raw_query);
+        std::string cache_key = BuildCanonicalQuery(query);
+        cache_key += '\x03';
+        cache_key += filter_key;
+        if (auto cached_documents = result_cache_->Find(cache_key, generation_)) {
+            return std::move(*cached_documents);
+        }
 
-        for (const std::string& word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
+        auto matched_documents = FindAllDocuments(ResolveQuery(query, arena.GetResource()), document_predicate, arena.GetResource());
+        auto top_documents = SelectTopDocuments(matched_documents);
+        result_cache_->Insert(std::move(cache_key), generation_, top_documents);
+
+        return top_documents;
+    }
+
+
+    // The documents and all the temporaries are allocated from the resource
+    template <typename DocumentPredicate, typename Scorer = TfIdfScorer>
+    std::pmr::vector<Document> FindAllDocuments(const ResolvedQuery& query, DocumentPredicate document_predicate, std::pmr::memory_resource* resource, const Scorer& scorer = Scorer()) const {
+        std::pmr::map<int, double> document_to_relevance(resource);
+
+        if (query.HasRequirements()) {
+            // Only the documents satisfying the requirements are scored, looking them up in the postings
+            const auto candidates = FindRequiredCandidates(query, resource);
+            TRACE_SPAN("AccumulateRelevance");
+            const CorpusStatistics corpus = GetCorpusStatistics();
+            std::pmr::vector<double> term_weights(resource);
+            for (const QueryTerm& term : query.plus_terms) {
+                term_weights.push_back(scorer.ComputeTermWeight(corpus, term.document_freqs->size()) * GetTermBoost(term));
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
+            for (const int document_id : candidates) {
                 const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                if (!document_predicate(document_id, document_data.status, document_data.rating)) {
+                    continue;
+                }
+                double relevance = 0.0;
+                for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+                    const auto it = query.plus_terms[i].document_freqs->find(document_id);
+                    if (it != query.plus_terms[i].document_freqs->end()) {
+                        relevance += scorer.Score(term_weights[i], it->second, document_data.word_count, corpus);
+                    }
+                }
+                document_to_relevance.emplace_hint(document_to_relevance.end(), document_id, relevance);
+            }
+        } else {
+            TRACE_SPAN("AccumulateRelevance");
+            const CorpusStatistics corpus = GetCorpusStatistics();
+            for (const QueryTerm& term : query.plus_terms) {
+                const double term_weight = scorer.ComputeTermWeight(corpus, term.document_freqs->size()) * GetTermBoost(term);
+                for (const auto [document_id, term_freq] : *term.document_freqs) {
+                    const auto& document_data = documents_.at(document_id);
+                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                        document_to_relevance[document_id] += scorer.Score(term_weight, term_freq, document_data.word_count, corpus);
+                    }
                 }
             }
         }
 
-        for (const std::string& word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
+        {
+            TRACE_SPAN("ExcludeMinusWords");
+            for (const auto* document_freqs : query.minus_terms) {
+                for (const auto [document_id, _] : *document_freqs) {
+                    document_to_relevance.erase(document_id);
+                }
             }
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
+        }
+
+        if (query.uses_positions) {
+            TRACE_SPAN("CheckPositions");
+            for (auto it = document_to_relevance.begin(); it != document_to_relevance.end();) {
+                const double factor = ComputePositionalFactor(query, it->first);
+                if (factor == 0.0) {
+                    it = document_to_relevance.erase(it);
+                } else {
+                    it->second *= factor;
+                    ++it;
+                }
             }
         }
 
-        std::vector<Document> matched_documents;
+        TRACE_SPAN("BuildResults");
+        std::pmr::vector<Document> matched_documents(resource);
+        matched_documents.reserve(document_to_relevance.size());
         for (const auto [document_id, relevance] : document_to_relevance) {
             matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
         }
@@ -329,39 +1022,38 @@ private:
     }
 
 
-    template <typename ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate) const {
-        if (!IsExecutionPolicyParallel(policy)) {
-            return FindAllDocuments(query, document_predicate);
+    template <typename ExecutionPolicy, typename DocumentPredicate, typename Scorer = TfIdfScorer>
+    std::vector<Document> FindAllDocuments(ExecutionPolicy& policy, const ResolvedQuery& query, DocumentPredicate document_predicate, const Scorer& scorer = Scorer()) const {
+        // The candidates of a query with requirements are few and are scored sequentially
+        if (!IsExecutionPolicyParallel(policy) || query.HasRequirements()) {
+            QueryArena::Scope arena;
+            const auto matched_documents = FindAllDocuments(query, document_predicate, arena.GetResource(), scorer);
+            return { matched_documents.begin(), matched_documents.end() };
         }
 
         ConcurrentMap<int, double> document_to_relevance(CONCURRENT_MEP_THREADS_COUNT);
 
+        TRACE_SPAN("AccumulateRelevance");
+        const CorpusStatistics corpus = GetCorpusStatistics();
         std::for_each(std::execution::par,
-            query.plus_words.begin(), query.plus_words.end(),
-            [this, &document_to_relevance, &document_predicate](const auto& word) {
+            query.plus_terms.begin(), query.plus_terms.end(),
+            [this, &document_to_relevance, &document_predicate, &scorer, &corpus](const QueryTerm& term) {
 
-                if (word_to_document_freqs_.count(word) == 0) {
-                    return;
-                }
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
+                const double term_weight = scorer.ComputeTermWeight(corpus, term.document_freqs->size()) * GetTermBoost(term);
+                for (const auto [document_id, term_freq] : *term.document_freqs) {
                     const auto& document_data = documents_.at(document_id);
                     if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+                        document_to_relevance[document_id].ref_to_value += scorer.Score(term_weight, term_freq, document_data.word_count, corpus);
                     }
                 }
 
             });
 
         std::for_each(std::execution::par,
-            query.minus_words.begin(), query.minus_words.end(),
-            [this, &document_to_relevance](const auto& word) {
+            query.minus_terms.begin(), query.minus_terms.end(),
+            [&document_to_relevance](const auto* document_freqs) {
 
-                if (word_to_document_freqs_.count(word) == 0) {
-                    return;
-                }
-                for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
+                for (const auto [document_id, _] : *document_freqs) {
                     document_to_relevance.Erase(document_id);
                 }
 
@@ -374,8 +1066,16 @@ private:
         std::for_each(
             std::execution::par,
             document_to_relevance_ordinary_map.begin(), document_to_relevance_ordinary_map.end(),
-            [this, &matched_documents, &vector_mutex](auto& item) {
-                Document item_to_move = { item.first, item.second, documents_.at(item.first).rating };
+            [this, &query, &matched_documents, &vector_mutex](auto& item) {
+                double relevance = item.second;
+                if (query.uses_positions) {
+                    const double factor = ComputePositionalFactor(query, item.first);
+                    if (factor == 0.0) {
+                        return;
+                    }
+                    relevance *= factor;
+                }
+                Document item_to_move = { item.first, relevance, documents_.at(item.first).rating };
                 std::lock_guard<std::mutex> guard(vector_mutex);
                 matched_documents.push_back(std::move(item_to_move));
             }
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+
+// Vector that keeps the first N elements inside the object and
+// moves all of them to the heap only when it grows beyond N.
+template <typename Type, size_t N>
+class SmallVector {
+public:
+    void push_back(const Type& value) {
+        if (size_ < N) {
+            inline_items_[size_] = value;
+        } else {
+            if (size_ == N) {
+                heap_items_.assign(inline_items_.begin(), inline_items_.end());
+            }
+            heap_items_.push_back(value);
+        }
+        ++size_;
+    }
+
+
+    // Only shrinking is supported
+    void resize(size_t size) {
+        if (size >= size_) {
+            return;
+        }
+        if (size_ > N) {
+            heap_items_.resize(size);
+            if (size <= N) {
+                std::copy(heap_items_.begin(), heap_items_.end(), inline_items_.begin());
+                heap_items_.clear();
+            }
+        }
+        size_ = size;
+    }
+
+
+    Type* begin() {
+        return data();
+    }
+
+
+    Type* end() {
+        return data() + size_;
+    }
+
+
+    const Type* begin() const {
+        return data();
+    }
+
+
+    const Type* end() const {
+        return data() + size_;
+    }
+
+
+    Type* data() {
+        return size_ > N ? heap_items_.data() : inline_items_.data();
+    }
+
+
+    const Type* data() const {
+        return size_ > N ? heap_items_.data() : inline_items_.data();
+    }
+
+
+    Type& operator[](size_t index) {
+        return data()[index];
+    }
+
+
+    const Type& operator[](size_t index) const {
+        return data()[index];
+    }
+
+
+    size_t size() const {
+        return size_;
+    }
+
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+private:
+    std::array<Type, N> inline_items_ = {};
+    std::vector<Type> heap_items_;
+    size_t size_ = 0;
+};
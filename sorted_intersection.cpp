@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstring>
+
+#include "sorted_intersection.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SEARCH_SERVER_HAS_SSE2
+#endif
+
+
+namespace {
+
+// An array this many times longer than the other one is skipped through by galloping
+constexpr size_t GALLOP_SIZE_RATIO = 32;
+
+
+// Every value of the short array is searched for in the long one, doubling the step from the last found position
+size_t IntersectByGalloping(const int* short_values, size_t short_size, const int* long_values, size_t long_size, int* output) {
+    size_t output_size = 0;
+    size_t long_index = 0;
+    for (size_t i = 0; i < short_size && long_index < long_size; ++i) {
+        const int value = short_values[i];
+        size_t step = 1;
+        while (long_index + step < long_size && long_values[long_index + step] < value) {
+            long_index += step;
+            step *= 2;
+        }
+        long_index = std::lower_bound(long_values + long_index, long_values + std::min(long_index + step + 1, long_size), value) - long_values;
+        if (long_index < long_size && long_values[long_index] == value) {
+            output[output_size++] = value;
+            ++long_index;
+        }
+    }
+    return output_size;
+}
+
+}  // namespace
+
+
+size_t IntersectSorted(const int* lhs, size_t lhs_size, const int* rhs, size_t rhs_size, int* output) {
+    if (rhs_size / GALLOP_SIZE_RATIO > lhs_size) {
+        return IntersectByGalloping(lhs, lhs_size, rhs, rhs_size, output);
+    }
+    if (lhs_size / GALLOP_SIZE_RATIO > rhs_size) {
+        return IntersectByGalloping(rhs, rhs_size, lhs, lhs_size, output);
+    }
+
+    size_t lhs_index = 0;
+    size_t rhs_index = 0;
+    size_t output_size = 0;
+
+#ifdef SEARCH_SERVER_HAS_SSE2
+    // Every block of lhs is compared with the four rotations of a block of rhs, and the block with
+    // the smaller last value is replaced. The block of lhs is copied, since output may overwrite it.
+    alignas(16) int lhs_block[4];
+    bool is_lhs_block_loaded = false;
+    __m128i lhs_values = _mm_setzero_si128();
+    while (lhs_index + 4 <= lhs_size && rhs_index + 4 <= rhs_size) {
+        if (!is_lhs_block_loaded) {
+            std::memcpy(lhs_block, lhs + lhs_index, sizeof(lhs_block));
+            lhs_values = _mm_load_si128(reinterpret_cast<const __m128i*>(lhs_block));
+            is_lhs_block_loaded = true;
+        }
+        const __m128i rhs_values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + rhs_index));
+        const __m128i equal = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(lhs_values, rhs_values),
+                _mm_cmpeq_epi32(lhs_values, _mm_shuffle_epi32(rhs_values, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(lhs_values, _mm_shuffle_epi32(rhs_values, _MM_SHUFFLE(1, 0, 3, 2))),
+                _mm_cmpeq_epi32(lhs_values, _mm_shuffle_epi32(rhs_values, _MM_SHUFFLE(2, 1, 0, 3)))));
+        const int mask = _mm_movemask_ps(_mm_castsi128_ps(equal));
+        for (int i = 0; i < 4; ++i) {
+            if (mask & (1 << i)) {
+                output[output_size++] = lhs_block[i];
+            }
+        }
+
+        const int lhs_max = lhs_block[3];
+        const int rhs_max = rhs[rhs_index + 3];
+        if (lhs_max <= rhs_max) {
+            lhs_index += 4;
+            is_lhs_block_loaded = false;
+        }
+        if (rhs_max <= lhs_max) {
+            rhs_index += 4;
+        }
+    }
+    if (is_lhs_block_loaded) {
+        // The values of the block already written can't occur in the rest of rhs
+        for (const int value : lhs_block) {
+            while (rhs_index < rhs_size && rhs[rhs_index] < value) {
+                ++rhs_index;
+            }
+            if (rhs_index < rhs_size && rhs[rhs_index] == value) {
+                output[output_size++] = value;
+                ++rhs_index;
+            }
+        }
+        lhs_index += 4;
+    }
+#endif
+
+    while (lhs_index < lhs_size && rhs_index < rhs_size) {
+        const int value = lhs[lhs_index];
+        if (value < rhs[rhs_index]) {
+            ++lhs_index;
+        } else if (rhs[rhs_index] < value) {
+            ++rhs_index;
+        } else {
+            output[output_size++] = value;
+            ++lhs_index;
+            ++rhs_index;
+        }
+    }
+    return output_size;
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+
+
+// Writes the values present in both strictly ascending arrays to output in ascending order and
+// returns their number. output may be lhs. Arrays of similar sizes are merged comparing blocks of four
+// values with SSE2 where it is available; a much longer array is skipped through by galloping.
+size_t IntersectSorted(const int* lhs, size_t lhs_size, const int* rhs, size_t rhs_size, int* output);
\ No newline at end of file
@@ -18,5 +18,15 @@ std::vector<std::string> SplitIntoWords(const std::string& text) {
         words.push_back(word);
     }
 
+    return words;
+}
+
+
+std::vector<std::string_view> SplitIntoWordViews(std::string_view text) {
+    std::vector<std::string_view> words;
+    ForEachWord(text, [&words](std::string_view word) {
+        words.push_back(word);
+        });
+
     return words;
 }
\ No newline at end of file
@@ -1,20 +1,68 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <set>
+#include <type_traits>
 #include <vector>
 
 
 std::vector<std::string> SplitIntoWords(const std::string& text);
 
 
+// Same as SplitIntoWords, but the words refer to the text instead of being copied
+std::vector<std::string_view> SplitIntoWordViews(std::string_view text);
+
+
+// Calls action for every word of the text without collecting them into a container
+template <typename Action>
+void ForEachWord(std::string_view text, Action action) {
+    while (true) {
+        const size_t word_begin = text.find_first_not_of(' ');
+        if (word_begin == std::string_view::npos) {
+            break;
+        }
+        text.remove_prefix(word_begin);
+        const size_t word_end = std::min(text.find(' '), text.size());
+        action(text.substr(0, word_end));
+        text.remove_prefix(word_end);
+    }
+}
+
+
 template <typename StringContainer>
-std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string> non_empty_strings;
-    for (const std::string& str : strings) {
+std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
+    std::set<std::string, std::less<>> non_empty_strings;
+    for (const auto& str : strings) {
         if (!str.empty()) {
-            non_empty_strings.insert(str);
+            non_empty_strings.emplace(str);
         }
     }
     return non_empty_strings;
+}
+
+
+// Hash of the set of words (the keys of a sorted map or the elements of a sorted set):
+// equal sets always have equal fingerprints
+template <typename SortedWords>
+uint64_t ComputeWordSetFingerprint(const SortedWords& words) {
+    // FNV-1a; the words are separated by '\0', which can't occur inside a word
+    constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+    constexpr uint64_t FNV_PRIME = 1099511628211ull;
+    uint64_t fingerprint = FNV_OFFSET_BASIS;
+    for (const auto& item : words) {
+        std::string_view word;
+        if constexpr (std::is_convertible_v<decltype(item), std::string_view>) {
+            word = item;
+        } else {
+            word = item.first;
+        }
+        for (const char c : word) {
+            fingerprint = (fingerprint ^ static_cast<unsigned char>(c)) * FNV_PRIME;
+        }
+        fingerprint *= FNV_PRIME;  // the '\0' separator
+    }
+    return fingerprint;
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "term_dictionary.h"
+
+
+void TermDictionary::PushBack(std::string_view word) {
+    using namespace std::string_literals;
+    if (size() > 0 && GetWord(size() - 1) >= word) {
+        throw std::invalid_argument("Words of a dictionary must be added in ascending order"s);
+    }
+    characters_ += word;
+    max_word_length_ = std::max(max_word_length_, word.size());
+    offsets_.push_back(static_cast<uint32_t>(characters_.size()));
+}
+
+
+size_t TermDictionary::size() const {
+    return offsets_.size() - 1;
+}
+
+
+std::string_view TermDictionary::GetWord(size_t index) const {
+    return std::string_view(characters_).substr(offsets_[index], offsets_[index + 1] - offsets_[index]);
+}
+
+
+std::vector<std::pair<std::string_view, int>> TermDictionary::FindWithinDistance(const LevenshteinAutomaton& automaton) const {
+    std::vector<std::pair<std::string_view, int>> result;
+    if (size() == 0) {
+        return result;
+    }
+    // The state and the viable characters after the first depth characters of the current prefix
+    const size_t state_size = automaton.GetStateSize();
+    std::vector<int> states((max_word_length_ + 1) * state_size);
+    std::vector<std::string> viable_characters(max_word_length_ + 1);
+    automaton.Start(states.data());
+
+    const auto get_character = [this](size_t index, size_t depth) {
+        return static_cast<unsigned char>(characters_[offsets_[index] + depth]);
+    };
+    // The first word of the range having the character at depth not less than c; all the words
+    // of the range share the first depth characters and are longer than depth
+    const auto find_first_not_less = [&get_character](size_t begin, size_t end, size_t depth, unsigned c) {
+        // Galloping first: the ranges of the children are usually short
+        if (begin == end || get_character(begin, depth) >= c) {
+            return begin;
+        }
+        size_t step = 1;
+        while (begin + step < end && get_character(begin + step, depth) < c) {
+            begin += step;
+            step *= 2;
+        }
+        end = std::min(end, begin + step);
+        ++begin;
+        while (begin < end) {
+            const size_t middle = begin + (end - begin) / 2;
+            if (get_character(middle, depth) < c) {
+                begin = middle + 1;
+            } else {
+                end = middle;
+            }
+        }
+        return begin;
+    };
+
+    const auto visit = [&](const auto& self, size_t begin, size_t end, size_t depth) -> void {
+        const int* state = states.data() + depth * state_size;
+        // The word equal to the prefix goes first
+        if (GetWord(begin).size() == depth) {
+            const int distance = automaton.GetDistance(state);
+            if (distance <= automaton.GetMaxDistance()) {
+                result.emplace_back(GetWord(begin), distance);
+            }
+            ++begin;
+        }
+
+        std::string& characters = viable_characters[depth];
+        const bool is_restricted = automaton.GetViableCharacters(state, characters);
+        size_t character_index = 0;
+        while (begin < end) {
+            unsigned c = get_character(begin, depth);
+            if (is_restricted) {
+                // Jumps over the children that would kill the automaton
+                while (character_index < characters.size() && static_cast<unsigned char>(characters[character_index]) < c) {
+                    ++character_index;
+                }
+                if (character_index == characters.size()) {
+                    break;
+                }
+                c = static_cast<unsigned char>(characters[character_index++]);
+                begin = find_first_not_less(begin, end, depth, c);
+                if (begin == end || get_character(begin, depth) != c) {
+                    continue;
+                }
+            }
+            const size_t child_end = find_first_not_less(begin, end, depth, c + 1);
+            int* next_state = states.data() + (depth + 1) * state_size;
+            automaton.Step(state, static_cast<char>(c), next_state);
+            if (!automaton.IsDead(next_state)) {
+                self(self, begin, child_end, depth + 1);
+            }
+            begin = child_end;
+        }
+    };
+    visit(visit, 0, size(), 0);
+    return result;
+}
+
+
+size_t TermDictionary::GetMemoryUsage() const {
+    return sizeof(*this) + characters_.capacity() + offsets_.capacity() * sizeof(uint32_t);
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "levenshtein_automaton.h"
+
+
+// Sorted words packed into one buffer. Walked as an implicit trie: the words starting
+// with a prefix form a range, which is split by the next character with binary searches.
+class TermDictionary {
+public:
+    // The words must be added in ascending order
+    void PushBack(std::string_view word);
+
+
+    size_t size() const;
+
+
+    std::string_view GetWord(size_t index) const;
+
+
+    // The words accepted by the automaton with their distances in ascending order of the words.
+    // Only the prefixes keeping the automaton alive are visited.
+    std::vector<std::pair<std::string_view, int>> FindWithinDistance(const LevenshteinAutomaton& automaton) const;
+
+
+    size_t GetMemoryUsage() const;
+
+private:
+    std::string characters_;
+    // The word i takes the characters from offsets_[i] to offsets_[i + 1]
+    std::vector<uint32_t> offsets_ = { 0 };
+    size_t max_word_length_ = 0;
+};
\ No newline at end of file
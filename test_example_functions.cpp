@@ -1,4 +1,6 @@
 #include <math.h>
+#include <forward_list>
+#include <sstream>
 
 #include "paginator.h"
 #include "test_example_functions.h"
@@ -6,6 +8,8 @@
 #include "string_processing.h"
 #include "process_queries.h"
 #include "remove_duplicates.h"
+#include "sorted_intersection.h"
+#include "text_analyzer.h"
 
 
 using namespace std;
@@ -1149,6 +1153,1537 @@ void TestFindTopDocumentsSpeed() {
 }
 
 
+void TestProcessQueriesBatch() {
+    SearchServer search_server("and with"s);
+
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(3, "funny pet and not very nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(4, "pet with rat and rat and rat"s, DocumentStatus::BANNED, { 1, 2 });
+    search_server.AddDocument(5, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+
+    // duplicates, reordered words and repeated words must give the same results as single queries
+    const vector<string> queries = {
+        "nasty rat -not"s,
+        "curly hair"s,
+        "rat nasty -not"s,
+        "nasty rat -not"s,
+        "hair curly curly"s,
+        "pet"s,
+        "unknown"s
+    };
+
+    const auto results = ProcessQueries(search_server, queries);
+    ASSERT_EQUAL(results.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto expected = search_server.FindTopDocuments(queries[i]);
+        ASSERT_EQUAL_HINT(results[i].size(), expected.size(), queries[i]);
+        for (size_t j = 0; j < expected.size(); ++j) {
+            ASSERT_EQUAL_HINT(results[i][j].id, expected[j].id, queries[i]);
+            ASSERT_HINT(abs(results[i][j].relevance - expected[j].relevance) < eps, queries[i]);
+        }
+    }
+
+    const auto banned = search_server.FindTopDocumentsBatch({ "rat"s, "rat"s }, DocumentStatus::BANNED);
+    ASSERT_EQUAL(banned[0].size(), 1);
+    ASSERT_EQUAL(banned[1].size(), 1);
+    ASSERT_EQUAL(banned[1][0].id, 4);
+
+    try {
+        ProcessQueries(search_server, { "curly"s, "curly --hair"s });
+        abort();
+    } catch (const invalid_argument& e) {
+        cout << "Cathced error: "s << e.what() << endl;
+    }
+}
+
+
+void TestSubmitFindTopDocuments() {
+    SearchServer search_server("and with"s);
+
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::BANNED, { 1, 2 });
+
+    try {
+        search_server.SubmitFindTopDocuments("curly"s);
+        abort();
+    } catch (const logic_error& e) {
+        cout << "Cathced error: "s << e.what() << endl;
+    }
+
+    search_server.StartQueryExecutor(2, 16);
+    vector<future<vector<Document>>> futures;
+    for (int i = 0; i < 1000; ++i) {
+        futures.push_back(search_server.SubmitFindTopDocuments(i % 2 ? "curly hair"s : "nasty -pet"s));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        const auto documents = futures[i].get();
+        ASSERT_EQUAL(documents.size(), i % 2 ? 1 : 0);
+    }
+    ASSERT_EQUAL(search_server.SubmitFindTopDocuments("rat"s, DocumentStatus::BANNED).get().size(), 1);
+
+    // exceptions of the query are delivered through the future
+    auto invalid = search_server.SubmitFindTopDocuments("curly --hair"s);
+    try {
+        invalid.get();
+        abort();
+    } catch (const invalid_argument& e) {
+        cout << "Cathced error: "s << e.what() << endl;
+    }
+
+    // a full queue rejects new queries
+    {
+        QueryExecutor executor(1, 1, QueryExecutor::OverflowPolicy::REJECT);
+        promise<void> release;
+        auto blocker = executor.Submit([gate = release.get_future().share()] {
+            gate.wait();
+        });
+        while (executor.GetQueueSize() != 0) {
+            this_thread::yield();
+        }
+        auto queued = executor.Submit([] {
+            return 42;
+        });
+        try {
+            executor.Submit([] {
+                return 0;
+            });
+            abort();
+        } catch (const runtime_error& e) {
+            cout << "Cathced error: "s << e.what() << endl;
+        }
+        release.set_value();
+        ASSERT_EQUAL(queued.get(), 42);
+    }
+}
+
+
+void TestResultCache() {
+    SearchServer search_server("and with"s);
+
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.EnableResultCache(1 << 20);
+
+    ASSERT_EQUAL(search_server.FindTopDocuments("curly pet"s).size(), 2);
+    ASSERT_EQUAL(search_server.GetResultCacheStats().misses, 1);
+
+    // the same normalised query is served from the cache
+    ASSERT_EQUAL(search_server.FindTopDocuments("pet curly pet"s).size(), 2);
+    ASSERT_EQUAL(search_server.GetResultCacheStats().hits, 1);
+
+    // another status is another cache entry
+    ASSERT_EQUAL(search_server.FindTopDocuments("curly pet"s, DocumentStatus::BANNED).size(), 0);
+    ASSERT_EQUAL(search_server.GetResultCacheStats().misses, 2);
+
+    // changing the index invalidates the cached results
+    const uint64_t generation = search_server.GetGeneration();
+    search_server.AddDocument(3, "curly dog"s, DocumentStatus::ACTUAL, { 1, 2 });
+    ASSERT(search_server.GetGeneration() != generation);
+    ASSERT_EQUAL(search_server.FindTopDocuments("curly pet"s).size(), 3);
+    ASSERT_EQUAL(search_server.GetResultCacheStats().invalidations, 1);
+    search_server.RemoveDocument(1);
+    ASSERT_EQUAL(search_server.FindTopDocuments("curly pet"s).size(), 2);
+
+    // predicates are cached only with a key supplied by the caller
+    const auto is_even = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    };
+    const auto hits = search_server.GetResultCacheStats().hits;
+    search_server.FindTopDocuments("curly"s, is_even);
+    search_server.FindTopDocuments("curly"s, is_even);
+    ASSERT_EQUAL(search_server.GetResultCacheStats().hits, hits);
+    search_server.FindTopDocuments("curly"s, is_even, ResultCacheKey{ "even"s });
+    ASSERT_EQUAL(search_server.FindTopDocuments("curly"s, is_even, ResultCacheKey{ "even"s }).size(), 1);
+    ASSERT_EQUAL(search_server.GetResultCacheStats().hits, hits + 1);
+
+    // the memory limit is respected by evicting the least recently used entries
+    {
+        ResultCache cache(2048, 1);
+        for (int i = 0; i < 100; ++i) {
+            cache.Insert("query "s + to_string(i), 0, { { i, 1.0, 1 } });
+        }
+        const auto stats = cache.GetStats();
+        ASSERT(stats.memory_usage <= 2048);
+        ASSERT(stats.evictions > 0);
+        ASSERT(cache.Find("query 99"s, 0).has_value());
+        ASSERT(!cache.Find("query 0"s, 0).has_value());
+        ASSERT(!cache.Find("query 99"s, 1).has_value());
+    }
+}
+
+
+void TestPreparedQuery() {
+    SearchServer search_server("and with"s);
+
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(3, "funny pet and not very nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+
+    const auto prepared_query = search_server.PrepareQuery("nasty curly pet -not"s);
+    const auto compare = [&search_server, &prepared_query](const string& raw_query) {
+        const auto expected = search_server.FindTopDocuments(raw_query);
+        const auto documents = search_server.FindTopDocuments(prepared_query);
+        ASSERT_EQUAL(documents.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(documents[i].id, expected[i].id);
+            ASSERT(abs(documents[i].relevance - expected[i].relevance) < eps);
+        }
+        ASSERT_EQUAL(search_server.FindTopDocuments(execution::par, prepared_query, DocumentStatus::ACTUAL).size(), expected.size());
+    };
+    compare("nasty curly pet -not"s);
+
+    // the prepared query follows changes of the index
+    search_server.AddDocument(4, "curly pet"s, DocumentStatus::ACTUAL, { 5 });
+    compare("nasty curly pet -not"s);
+    search_server.RemoveDocument(2);
+    compare("nasty curly pet -not"s);
+
+    {
+        const auto [words, status] = search_server.MatchDocument(prepared_query, 1);
+        ASSERT_EQUAL(words.size(), 2);
+        ASSERT_EQUAL(words[0], "nasty"s);
+        ASSERT_EQUAL(words[1], "pet"s);
+    }
+    {
+        const auto [words, status] = search_server.MatchDocument(prepared_query, 3);
+        ASSERT(words.empty());
+    }
+    ASSERT_EQUAL(search_server.FindTopDocuments(prepared_query, DocumentStatus::BANNED).size(), 0);
+
+    try {
+        search_server.PrepareQuery("curly --hair"s);
+        abort();
+    } catch (const invalid_argument& e) {
+        cout << "Cathced error: "s << e.what() << endl;
+    }
+
+    SearchServer another_server("and with"s);
+    try {
+        another_server.FindTopDocuments(prepared_query);
+        abort();
+    } catch (const invalid_argument& e) {
+        cout << "Cathced error: "s << e.what() << endl;
+    }
+}
+
+
+void TestQueryParsing() {
+    SearchServer search_server("and with"s);
+
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+
+    // the query is a part of a longer text and is not followed by '\0'
+    const string text = "curly hair -funny"s;
+    ASSERT_EQUAL(search_server.FindTopDocuments(string_view(text).substr(0, 10)).size(), 1);
+    ASSERT_EQUAL(search_server.FindTopDocuments(string_view(text)).size(), 0);
+
+    // repeated words are counted once
+    const auto once = search_server.FindTopDocuments("curly pet"s);
+    const auto twice = search_server.FindTopDocuments("  pet curly   curly pet "s);
+    ASSERT_EQUAL(once.size(), twice.size());
+    ASSERT(abs(once[0].relevance - twice[0].relevance) < eps);
+
+    // more words than fit into the inline storage of the query
+    string long_query;
+    for (int i = 0; i < 30; ++i) {
+        long_query += "word"s + to_string(i) + " -minus"s + to_string(i) + " "s;
+    }
+    ASSERT_EQUAL(search_server.FindTopDocuments(long_query + "hair"s).size(), 1);
+    ASSERT_EQUAL(search_server.FindTopDocuments(long_query + "hair -curly"s).size(), 0);
+
+    for (const string& invalid_query : { "curly --hair"s, "curly -"s, "cur\x12ly"s, "-cur\x12ly"s }) {
+        try {
+            search_server.FindTopDocuments(invalid_query);
+            abort();
+        } catch (const invalid_argument& e) {
+            cout << "Cathced error: "s << e.what() << endl;
+        }
+    }
+}
+
+
+void TestQueryArena() {
+    // memory of the outer scope stays valid when a nested scope ends
+    {
+        QueryArena::Scope outer;
+        std::pmr::vector<int> numbers(outer.GetResource());
+        numbers.assign(1000, 7);
+        {
+            QueryArena::Scope inner;
+            std::pmr::vector<int> other_numbers(inner.GetResource());
+            other_numbers.assign(1000, 13);
+        }
+        ASSERT_EQUAL(count(numbers.begin(), numbers.end(), 7), 1000);
+    }
+
+    // queries whose temporaries don't fit into the arena buffer
+    SearchServer search_server("and with"s);
+    for (int id = 0; id < 20'000; ++id) {
+        search_server.AddDocument(id, "curly cat number"s + to_string(id % 100), DocumentStatus::ACTUAL, { id % 7 });
+    }
+    const auto sequential = search_server.FindTopDocuments("curly -number5"s);
+    const auto parallel = search_server.FindTopDocuments(execution::par, "curly -number5"s);
+    ASSERT_EQUAL(sequential.size(), SearchServer::MAX_RESULT_DOCUMENT_COUNT);
+    ASSERT_EQUAL(sequential.size(), parallel.size());
+    for (size_t i = 0; i < sequential.size(); ++i) {
+        ASSERT_EQUAL(sequential[i].rating, parallel[i].rating);
+        ASSERT(abs(sequential[i].relevance - parallel[i].relevance) < eps);
+    }
+    ASSERT_EQUAL(search_server.FindTopDocuments("curly -number5"s)[0].rating, sequential[0].rating);
+}
+
+
+void TestMatchDocumentConcurrency() {
+    SearchServer search_server("and with"s);
+
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::BANNED, { 1, 2 });
+    search_server.AddDocument(3, "and with"s, DocumentStatus::ACTUAL, { 1, 2 });
+
+    // results of different calls don't share storage
+    const auto [first_words, first_status] = search_server.MatchDocument("funny nasty"s, 1);
+    const auto [second_words, second_status] = search_server.MatchDocument(execution::par, "curly hair pet"s, 2);
+    ASSERT_EQUAL(first_words.size(), 2);
+    ASSERT_EQUAL(first_words[0], "funny"s);
+    ASSERT_EQUAL(first_words[1], "nasty"s);
+    ASSERT_EQUAL(second_words.size(), 3);
+    ASSERT_EQUAL(second_words[0], "curly"s);
+    ASSERT(second_status == DocumentStatus::BANNED);
+
+    // the words stay valid after the query text is gone
+    vector<string_view> words;
+    {
+        string query = "rat pet -curly"s;
+        words = get<0>(search_server.MatchDocument(query, 1));
+        query.assign(query.size(), 'x');
+    }
+    ASSERT_EQUAL(words.size(), 2);
+    ASSERT_EQUAL(words[0], "pet"s);
+    ASSERT_EQUAL(words[1], "rat"s);
+
+    // a document that consists only of stop words
+    ASSERT(get<0>(search_server.MatchDocument("funny"s, 3)).empty());
+    try {
+        search_server.MatchDocument("funny"s, 4);
+        abort();
+    } catch (const out_of_range& e) {
+        cout << "Cathced error: "s << e.what() << endl;
+    }
+
+    vector<int> ids(1000);
+    for (int i = 0; i < 1000; ++i) {
+        ids[i] = i % 2 + 1;
+    }
+    vector<size_t> counts(ids.size());
+    transform(execution::par, ids.begin(), ids.end(), counts.begin(), [&search_server](int id) {
+        const auto [matched_words, status] = search_server.MatchDocument(execution::par, "funny pet curly -rat"s, id);
+        return matched_words.size();
+    });
+    for (size_t i = 0; i < ids.size(); ++i) {
+        ASSERT_EQUAL(counts[i], ids[i] == 1 ? 0 : 3);
+    }
+}
+
+
+void TestMatchDocuments() {
+    SearchServer search_server("and with"s);
+
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::BANNED, { 1, 2 });
+    search_server.AddDocument(3, "funny pet and not very nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(4, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(5, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+
+    const string query = "curly and funny nasty -not unknown"s;
+    const vector<int> ids = { 5, 4, 3, 2, 1, 2 };
+    for (const auto& matched_documents : { search_server.MatchDocuments(query, ids), search_server.MatchDocuments(execution::par, query, ids) }) {
+        ASSERT_EQUAL(matched_documents.size(), ids.size());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            const auto [words, status] = search_server.MatchDocument(query, ids[i]);
+            ASSERT(matched_documents.GetWords(i) == words);
+            ASSERT(matched_documents.statuses[i] == status);
+        }
+    }
+
+    try {
+        search_server.MatchDocuments(query, { 1, 6 });
+        abort();
+    } catch (const out_of_range& e) {
+        cout << "Cathced error: "s << e.what() << endl;
+    }
+    try {
+        search_server.MatchDocuments("funny --pet"s, { 1 });
+        abort();
+    } catch (const invalid_argument& e) {
+        cout << "Cathced error: "s << e.what() << endl;
+    }
+}
+
+
+void TestRemoveDuplicatesByFingerprint() {
+    SearchServer search_server("and with"s);
+
+    // the lowest id is kept even if it was added later
+    search_server.AddDocument(10, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(5, "rat nasty funny pet"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(7, "pet pet rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(3, "and with"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(4, "with"s, DocumentStatus::ACTUAL, { 1, 2 });
+    for (int id = 100; id < 1100; ++id) {
+        search_server.AddDocument(id, "word"s + to_string(id % 10) + " common"s, DocumentStatus::ACTUAL, { 1 });
+    }
+
+    RemoveDuplicates(search_server);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 3 + 10);
+    const vector<int> ids(search_server.begin(), search_server.end());
+    ASSERT(count(ids.begin(), ids.end(), 5) == 1);
+    ASSERT(count(ids.begin(), ids.end(), 10) == 0);
+    ASSERT(count(ids.begin(), ids.end(), 3) == 1);
+    for (int id = 100; id < 110; ++id) {
+        ASSERT(count(ids.begin(), ids.end(), id) == 1);
+    }
+    ASSERT_EQUAL(search_server.FindTopDocuments("common"s).size(), SearchServer::MAX_RESULT_DOCUMENT_COUNT);
+    ASSERT_EQUAL(search_server.FindTopDocuments("nasty"s)[0].id, 5);
+
+    // batch removal ignores unknown and repeated ids
+    search_server.RemoveDocuments({ 5, 5, 42, 7 });
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 11);
+    ASSERT(search_server.FindTopDocuments("rat"s).empty());
+    ASSERT(search_server.GetWordFrequencies(7).empty());
+
+    search_server.RemoveDocument(execution::par, 100);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 10);
+    ASSERT(search_server.FindTopDocuments("word0"s).empty());
+}
+
+
+void TestFindNearDuplicates() {
+    SearchServer search_server("and"s);
+
+    const string base = "alpha beta gamma delta epsilon zeta eta theta iota kappa"s;
+    search_server.AddDocument(8, base, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(3, base + " lambda"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(5, "alpha beta gamma delta epsilon zeta eta theta iota mu"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(6, "cat and dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(7, "dog cat"s, DocumentStatus::ACTUAL, { 1 });
+    for (int id = 100; id < 200; ++id) {
+        search_server.AddDocument(id, "unique"s + to_string(id) + " other"s + to_string(id) + " common"s, DocumentStatus::ACTUAL, { 1 });
+    }
+
+    const vector<vector<int>> clusters = FindNearDuplicates(search_server);
+    ASSERT_EQUAL(clusters.size(), 2u);
+    ASSERT((clusters[0] == vector<int>{ 3, 5, 8 }));
+    ASSERT((clusters[1] == vector<int>{ 6, 7 }));
+
+    // a strict threshold leaves only the identical word sets
+    NearDuplicateOptions strict;
+    strict.similarity_threshold = 1.0;
+    ASSERT((FindNearDuplicates(search_server, strict) == vector<vector<int>>{ { 6, 7 } }));
+
+    try {
+        NearDuplicateOptions invalid;
+        invalid.band_count = 0;
+        FindNearDuplicates(search_server, invalid);
+        ASSERT_HINT(false, "Options without bands must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+
+    // the first band puts 1 and 3 into a bucket, the second one puts all three documents into a bucket,
+    // where 3 is still compared with 2 after it was found in the cluster of 1
+    {
+        SearchServer chain_server(""s);
+        chain_server.AddDocument(1, "apple cherry banana mango"s, DocumentStatus::ACTUAL, { 1 });
+        chain_server.AddDocument(2, "banana mango grape lemon melon"s, DocumentStatus::ACTUAL, { 1 });
+        chain_server.AddDocument(3, "apple cherry banana mango grape lemon"s, DocumentStatus::ACTUAL, { 1 });
+        NearDuplicateOptions options;
+        options.band_count = 2;
+        options.rows_per_band = 1;
+        options.similarity_threshold = 0.5;
+        ASSERT((FindNearDuplicates(chain_server, options) == vector<vector<int>>{ { 1, 2, 3 } }));
+    }
+
+    RemoveNearDuplicates(search_server);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 102);
+    ASSERT_EQUAL(search_server.FindTopDocuments("alpha"s)[0].id, 3);
+    ASSERT_EQUAL(search_server.FindTopDocuments("dog"s)[0].id, 6);
+    ASSERT(FindNearDuplicates(search_server).empty());
+}
+
+
+void TestDuplicatePolicy() {
+    SearchServer search_server("and"s);
+    ASSERT(search_server.GetDuplicatePolicy() == SearchServer::DuplicatePolicy::ALLOW);
+    search_server.AddDocument(1, "funny pet"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "pet and funny pet"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+
+    search_server.SetDuplicatePolicy(SearchServer::DuplicatePolicy::REJECT);
+    try {
+        search_server.AddDocument(3, "funny funny pet"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_HINT(false, "Duplicate must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+    search_server.AddDocument(3, "funny pet cat"s, DocumentStatus::ACTUAL, { 1 });
+
+    // skipped duplicates don't change the statistics of the index
+    search_server.SetDuplicatePolicy(SearchServer::DuplicatePolicy::REPORT);
+    search_server.AddDocument(5, "dog"s, DocumentStatus::ACTUAL, { 1 });
+    const double relevance = search_server.FindTopDocuments("cat"s)[0].relevance;
+    search_server.AddDocument(4, "cat pet funny"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 4);
+    ASSERT((search_server.GetSkippedDuplicates() == map<int, int>{ { 4, 3 } }));
+    ASSERT(abs(search_server.FindTopDocuments("cat"s)[0].relevance - relevance) < SearchServer::eps);
+
+    // removal keeps the fingerprint index consistent
+    search_server.RemoveDocument(1);
+    search_server.AddDocument(6, "funny pet"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(search_server.GetSkippedDuplicates().at(6), 2);
+    search_server.RemoveDocument(execution::par, 2);
+    search_server.RemoveDocuments({ 3 });
+    search_server.AddDocument(6, "funny pet"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(4, "cat pet funny"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 3);
+    ASSERT(search_server.GetSkippedDuplicates().empty());
+}
+
+
+void TestConcurrentRequestQueue() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "funny pet"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "nasty rat"s, DocumentStatus::BANNED, { 1 });
+
+    {
+        ConcurrentRequestQueue request_queue(search_server);
+        ASSERT(request_queue.GetWindow() == chrono::hours(24));
+        vector<thread> threads;
+        for (int i = 0; i < 8; ++i) {
+            threads.emplace_back([&request_queue]() {
+                for (int j = 0; j < 500; ++j) {
+                    request_queue.AddFindRequest("empty request"s);
+                    ASSERT_EQUAL(request_queue.AddFindRequest("pet"s).size(), 1u);
+                    request_queue.AddFindRequest("rat"s, DocumentStatus::BANNED);
+                }
+                });
+        }
+        for (thread& t : threads) {
+            t.join();
+        }
+        ASSERT_EQUAL(request_queue.GetRequestCount(), 8 * 500 * 3);
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), 8 * 500);
+    }
+
+    {
+        // the old periods leave the window by themselves
+        ConcurrentRequestQueue request_queue(search_server, chrono::milliseconds(50), chrono::milliseconds(10));
+        ASSERT_EQUAL(request_queue.AddFindRequest("empty request"s, [](int, DocumentStatus, int) { return true; }).size(), 0u);
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1);
+        this_thread::sleep_for(chrono::milliseconds(80));
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), 0);
+        request_queue.AddFindRequest("empty request"s);
+        request_queue.AddFindRequest("pet"s);
+        ASSERT_EQUAL(request_queue.GetRequestCount(), 2);
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1);
+    }
+
+    try {
+        ConcurrentRequestQueue request_queue(search_server, chrono::hours(1), chrono::seconds(0));
+        ASSERT_HINT(false, "Zero granularity must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+
+void TestRequestStatistics() {
+    {
+        Histogram histogram;
+        ASSERT_EQUAL(histogram.GetValueAtPercentile(50.0), 0u);
+        for (uint64_t value = 1; value <= 100000; ++value) {
+            histogram.Record(value);
+        }
+        ASSERT_EQUAL(histogram.GetTotalCount(), 100000u);
+        for (const double percentile : { 50.0, 90.0, 99.0, 99.9 }) {
+            const double expected = percentile * 1000.0;
+            const double error = abs(static_cast<double>(histogram.GetValueAtPercentile(percentile)) - expected) / expected;
+            ASSERT_HINT(error < 0.035, "percentile "s + to_string(percentile));
+        }
+        ASSERT_EQUAL(Histogram::GetBucketIndex(Histogram::MAX_VALUE), Histogram::BUCKET_COUNT - 1);
+        ASSERT_EQUAL(Histogram::GetBucketIndex(Histogram::MAX_VALUE * 2), Histogram::BUCKET_COUNT - 1);
+        for (size_t index = 0; index < Histogram::BUCKET_COUNT; ++index) {
+            ASSERT_EQUAL(Histogram::GetBucketIndex(Histogram::GetBucketUpperBound(index)), index);
+        }
+    }
+
+    {
+        RequestStatistics statistics;
+        vector<thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&statistics, i]() {
+                for (int j = 0; j < 1000; ++j) {
+                    statistics.Record(chrono::microseconds(j < 990 ? 10 : 1000), static_cast<size_t>(i));
+                }
+                });
+        }
+        for (thread& t : threads) {
+            t.join();
+        }
+        statistics.Record(chrono::microseconds(10), 100);
+        const RequestStatistics::Report report = statistics.GetReport();
+        ASSERT_EQUAL(report.request_count, 4001u);
+        ASSERT(report.queries_per_second > 0.0);
+        ASSERT(report.latency_p50 >= chrono::microseconds(10) && report.latency_p50 < chrono::microseconds(11));
+        ASSERT(report.latency_p99 < chrono::microseconds(11));
+        ASSERT(report.latency_p999 >= chrono::microseconds(1000) && report.latency_p999 < chrono::microseconds(1040));
+        ASSERT_EQUAL(report.result_count_distribution.size(), RequestStatistics::RESULT_COUNT_LIMIT + 1);
+        ASSERT_EQUAL(report.result_count_distribution[0], 1000u);
+        ASSERT_EQUAL(report.result_count_distribution[3], 1000u);
+        ASSERT_EQUAL(report.result_count_distribution[RequestStatistics::RESULT_COUNT_LIMIT], 1u);
+    }
+
+    {
+        SearchServer search_server("and"s);
+        search_server.AddDocument(1, "funny pet"s, DocumentStatus::ACTUAL, { 1 });
+        RequestQueue request_queue(search_server);
+        try {
+            request_queue.GetStatistics();
+            ASSERT_HINT(false, "Statistics of a request queue must be disabled by default"s);
+        } catch (const logic_error&) {
+        }
+        request_queue.EnableStatistics();
+        ConcurrentRequestQueue concurrent_request_queue(search_server, chrono::hours(1), chrono::minutes(1), chrono::milliseconds(50), chrono::milliseconds(10));
+        for (int i = 0; i < 10; ++i) {
+            request_queue.AddFindRequest("pet"s);
+            concurrent_request_queue.AddFindRequest("cat"s);
+        }
+        ASSERT_EQUAL(request_queue.GetStatistics().request_count, 10u);
+        ASSERT_EQUAL(request_queue.GetStatistics().result_count_distribution[1], 10u);
+        ASSERT_EQUAL(concurrent_request_queue.GetStatistics().result_count_distribution[0], 10u);
+        this_thread::sleep_for(chrono::milliseconds(80));
+        ASSERT_EQUAL(concurrent_request_queue.GetStatistics().request_count, 0u);
+        ASSERT_EQUAL(concurrent_request_queue.GetRequestCount(), 10);
+    }
+
+    {
+        // a thread alternating between more instances than it caches keeps recording into its own shards
+        vector<RequestStatistics> all_statistics(10);
+        for (int j = 0; j < 100; ++j) {
+            for (RequestStatistics& statistics : all_statistics) {
+                statistics.Record(chrono::microseconds(10), 1);
+            }
+        }
+        for (const RequestStatistics& statistics : all_statistics) {
+            ASSERT_EQUAL(statistics.GetReport().request_count, 100u);
+        }
+        thread([&all_statistics]() {
+            all_statistics[0].Record(chrono::microseconds(10), 1);
+            }).join();
+        ASSERT_EQUAL(all_statistics[0].GetReport().request_count, 101u);
+    }
+}
+
+
+void TestProfiler() {
+#ifndef SEARCH_SERVER_DISABLE_PROFILING
+    const auto get_section = [](string_view name) {
+        for (const Profiler::SectionReport& section : Profiler::GetReport()) {
+            if (section.name == name) {
+                return section;
+            }
+        }
+        return Profiler::SectionReport{ name };
+    };
+
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "funny pet"s, DocumentStatus::ACTUAL, { 1 });
+    const uint64_t call_count = get_section("FindTopDocuments"sv).call_count;
+    vector<thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&search_server]() {
+            for (int j = 0; j < 100; ++j) {
+                search_server.FindTopDocuments("pet"s, [](int, DocumentStatus, int) { return true; });
+            }
+            });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    const Profiler::SectionReport section = get_section("FindTopDocuments"sv);
+    ASSERT_EQUAL(section.call_count, call_count + 400);
+    ASSERT(section.max_duration <= section.total_duration);
+
+    ASSERT_EQUAL(Profiler::RegisterSection("FindTopDocuments"sv), Profiler::RegisterSection("FindTopDocuments"sv));
+    {
+        PROFILE_SCOPE("TestProfiler");
+    }
+    ASSERT_EQUAL(get_section("TestProfiler"sv).call_count, 1u);
+    ostringstream output;
+    Profiler::PrintReport(output);
+    ASSERT(output.str().find("TestProfiler: 1 calls"s) != string::npos);
+#endif
+}
+
+
+void TestTracer() {
+#ifndef SEARCH_SERVER_DISABLE_TRACING
+    const auto count_occurrences = [](const string& text, const string& pattern) {
+        int count = 0;
+        for (size_t pos = text.find(pattern); pos != string::npos; pos = text.find(pattern, pos + 1)) {
+            ++count;
+        }
+        return count;
+    };
+
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "funny pet"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "nasty rat"s, DocumentStatus::ACTUAL, { 1 });
+
+    // a thread that records nothing allocates no buffer
+    Tracer::ReleaseFinishedThreads();
+    thread([&]() {
+        ASSERT_EQUAL(Tracer::GetSamplingRate(), 0u);
+        search_server.FindTopDocuments("pet -rat"s);
+        }).join();
+    ASSERT_EQUAL(Tracer::ReleaseFinishedThreads(), 0u);
+
+    // nothing is recorded until sampling is enabled; the test runs in its own thread, so its buffer is fresh
+    thread([&]() {
+        search_server.FindTopDocuments("pet -rat"s);
+        Tracer::SetSamplingRate(2);
+        for (int i = 0; i < 10; ++i) {
+            search_server.FindTopDocuments("pet -rat"s);
+        }
+        for (int i = 0; i < 10; ++i) {
+            search_server.MatchDocument("pet"s, 1);
+        }
+        Tracer::SetSamplingRate(0);
+        }).join();
+
+    ostringstream output;
+    Tracer::WriteChromeTrace(output);
+    const string trace = output.str();
+    ASSERT(trace.rfind("{\"traceEvents\":["s, 0) == 0);
+    ASSERT(trace.find("\"ph\":\"X\""s) != string::npos);
+    ASSERT(count_occurrences(trace, "\"name\":\"FindTopDocuments\""s) >= 5);
+    ASSERT(count_occurrences(trace, "\"name\":\"ParseQuery\""s) >= 10);
+    ASSERT(count_occurrences(trace, "\"name\":\"ExcludeMinusWords\""s) >= 5);
+    ASSERT(count_occurrences(trace, "\"name\":\"MatchWords\""s) >= 5);
+    ASSERT_EQUAL(count_occurrences(trace, "{\"name\""s), count_occurrences(trace, "\"dur\":"s));
+
+    // the spans of the finished thread are dropped with its buffer
+    ASSERT_EQUAL(Tracer::ReleaseFinishedThreads(), 1u);
+    ostringstream released_output;
+    Tracer::WriteChromeTrace(released_output);
+    ASSERT_EQUAL(count_occurrences(released_output.str(), "\"name\":\"FindTopDocuments\""s), 0);
+#endif
+}
+
+
+void TestWorkloadCapture() {
+    stringstream log;
+    {
+        SearchServer search_server("and with"s);
+        search_server.AddDocument(1, "not recorded"s, DocumentStatus::ACTUAL, { 1 });
+        search_server.SetWorkloadRecorder(make_shared<WorkloadRecorder>(log));
+        search_server.AddDocument(2, "funny pet"s, DocumentStatus::BANNED, { -300, 7 });
+        RequestQueue request_queue(search_server);
+        request_queue.AddFindRequest("pet -rat"s, DocumentStatus::BANNED);
+        request_queue.AddFindRequest("pet"s, [](int, DocumentStatus, int) { return true; });
+        search_server.RemoveDocument(1);
+        search_server.RemoveDocuments({ 2, 42 });
+        ASSERT_EQUAL(search_server.GetWorkloadRecorder()->GetOperationCount(), 6u);
+        search_server.SetWorkloadRecorder(nullptr);
+        search_server.AddDocument(3, "not recorded"s, DocumentStatus::ACTUAL, { 1 });
+    }
+
+    WorkloadReader reader(log);
+    vector<WorkloadOperation> operations;
+    while (auto operation = reader.ReadNext()) {
+        operations.push_back(move(*operation));
+    }
+    ASSERT_EQUAL(operations.size(), 6u);
+    ASSERT(operations[0].type == WorkloadOperationType::SET_STOP_WORDS);
+    ASSERT_EQUAL(operations[0].text, "and with "s);
+    ASSERT(operations[1].type == WorkloadOperationType::ADD_DOCUMENT);
+    ASSERT_EQUAL(operations[1].document_id, 2);
+    ASSERT(operations[1].status == DocumentStatus::BANNED);
+    ASSERT((operations[1].ratings == vector<int>{ -300, 7 }));
+    ASSERT_EQUAL(operations[1].text, "funny pet"s);
+    ASSERT(operations[2].type == WorkloadOperationType::FIND_TOP_DOCUMENTS);
+    ASSERT_EQUAL(operations[2].text, "pet -rat"s);
+    ASSERT(operations[2].status == DocumentStatus::BANNED && !operations[2].has_custom_predicate);
+    ASSERT(operations[3].has_custom_predicate);
+    ASSERT(operations[4].type == WorkloadOperationType::REMOVE_DOCUMENT && operations[4].document_id == 1);
+    ASSERT(operations[5].type == WorkloadOperationType::REMOVE_DOCUMENT && operations[5].document_id == 2);
+    for (size_t i = 1; i < operations.size(); ++i) {
+        ASSERT(operations[i - 1].timestamp <= operations[i].timestamp);
+    }
+
+    // a truncated log is reported
+    string truncated = log.str();
+    truncated.resize(truncated.size() - 1);
+    istringstream truncated_log(truncated);
+    WorkloadReader truncated_reader(truncated_log);
+    try {
+        while (truncated_reader.ReadNext()) {
+        }
+        ASSERT_HINT(false, "Truncated log must be reported"s);
+    } catch (const runtime_error&) {
+    }
+}
+
+
+void TestLazyPaginator() {
+    const vector<int> numbers = { 1, 2, 3, 4, 5, 6, 7 };
+    const auto pages = Paginate(numbers, 3);
+    ASSERT_EQUAL(pages.size(), 3u);
+    ASSERT_EQUAL(pages.page(0).size(), 3u);
+    ASSERT_EQUAL(*pages.page(1).begin(), 4);
+    ASSERT_EQUAL(pages.page(2).size(), 1u);
+    ASSERT_EQUAL(*pages.page(2).begin(), 7);
+    try {
+        pages.page(3);
+        ASSERT_HINT(false, "Page out of range must be reported"s);
+    } catch (const out_of_range&) {
+    }
+    ASSERT_EQUAL(Paginate(vector<int>(), 3).size(), 0u);
+    ASSERT(Paginate(vector<int>(), 3).begin() == Paginate(vector<int>(), 3).end());
+
+    // forward iterators are paged one page at a time
+    const forward_list<int> list(numbers.begin(), numbers.end());
+    vector<size_t> page_sizes;
+    for (const auto page : Paginate(list, 2)) {
+        page_sizes.push_back(page.size());
+    }
+    ASSERT((page_sizes == vector<size_t>{ 2, 2, 2, 1 }));
+    ASSERT_EQUAL(Paginate(list, 2).size(), 4u);
+
+    // every page is read once to find its end and once more by the caller, so no item is lost
+    vector<int> paged_numbers;
+    for (const auto page : Paginate(list, 3)) {
+        paged_numbers.insert(paged_numbers.end(), page.begin(), page.end());
+    }
+    ASSERT(paged_numbers == numbers);
+
+    try {
+        Paginate(numbers, 0);
+        ASSERT_HINT(false, "Zero page size must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+
+void TestFindTopDocumentsPage() {
+    SearchServer search_server("and"s);
+    // equal relevances are ordered by rating and then by id
+    for (int id = 0; id < 23; ++id) {
+        search_server.AddDocument(id, "cat "s + (id % 3 == 0 ? "cat"s : "dog"s), id == 7 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id % 4 });
+    }
+    search_server.AddDocument(100, "mouse"s, DocumentStatus::ACTUAL, { 1 });
+
+    vector<Document> expected;
+    for (int id = 0; id < 23; ++id) {
+        if (id != 7) {
+            expected.push_back({ id, 0.0, id % 4 });
+        }
+    }
+    stable_sort(expected.begin(), expected.end(), [](const Document& lhs, const Document& rhs) {
+        return make_pair(lhs.id % 3 == 0, lhs.rating) > make_pair(rhs.id % 3 == 0, rhs.rating);
+        });
+
+    vector<Document> all_pages;
+    SearchCursor cursor;
+    int page_count = 0;
+    while (true) {
+        // the cursor survives a round trip through its token
+        const SearchPage page = search_server.FindTopDocumentsPage("cat"s, SearchCursor::FromString(cursor.ToString()), 5);
+        ++page_count;
+        ASSERT(page.documents.size() <= 5u);
+        all_pages.insert(all_pages.end(), page.documents.begin(), page.documents.end());
+        if (!page.next_cursor) {
+            break;
+        }
+        cursor = *page.next_cursor;
+    }
+    ASSERT_EQUAL(page_count, 5);
+    ASSERT_EQUAL(all_pages.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL(all_pages[i].id, expected[i].id);
+    }
+
+    // the first page agrees with FindTopDocuments
+    const auto top_documents = search_server.FindTopDocuments("cat"s);
+    const auto first_page = search_server.FindTopDocumentsPage("cat"s, SearchCursor(), SearchServer::MAX_RESULT_DOCUMENT_COUNT);
+    for (size_t i = 0; i < top_documents.size(); ++i) {
+        ASSERT(abs(top_documents[i].relevance - first_page.documents[i].relevance) < SearchServer::eps);
+        ASSERT_EQUAL(top_documents[i].rating, first_page.documents[i].rating);
+    }
+
+    ASSERT_EQUAL(search_server.FindTopDocumentsPage("cat"s, SearchCursor(), 5, DocumentStatus::BANNED).documents.size(), 1u);
+    ASSERT(!search_server.FindTopDocumentsPage("cat"s, SearchCursor(), 22).next_cursor);
+    ASSERT(search_server.FindTopDocumentsPage("cat"s, SearchCursor(), 21).next_cursor.has_value());
+    ASSERT(SearchCursor::FromString(""s).IsStart());
+
+    {
+        // relevances chained within eps: every neighbour is within eps, the ends are not
+        vector<Document> chain;
+        for (int i = 0; i < 12; ++i) {
+            chain.push_back({ i, 1.0 + i * 0.4 * SearchServer::eps, 12 - i });
+        }
+        const auto is_before = [](const Document& lhs, const Document& rhs) {
+            return SearchCursor::IsBefore(lhs, rhs, SearchServer::eps);
+        };
+        for (const Document& a : chain) {
+            ASSERT(!is_before(a, a));
+            for (const Document& b : chain) {
+                for (const Document& c : chain) {
+                    if (is_before(a, b) && is_before(b, c)) {
+                        ASSERT(is_before(a, c));
+                    }
+                    if (!is_before(a, b) && !is_before(b, a) && !is_before(b, c) && !is_before(c, b)) {
+                        ASSERT(!is_before(a, c) && !is_before(c, a));
+                    }
+                }
+            }
+        }
+        // paging by cursor neither skips nor repeats documents
+        vector<Document> sorted_chain = chain;
+        sort(sorted_chain.begin(), sorted_chain.end(), is_before);
+        vector<int> paged_ids;
+        SearchCursor chain_cursor;
+        while (paged_ids.size() < chain.size()) {
+            const auto next = find_if(sorted_chain.begin(), sorted_chain.end(), [&chain_cursor](const Document& document) {
+                return chain_cursor.IsBefore(document, SearchServer::eps);
+                });
+            ASSERT(next != sorted_chain.end());
+            paged_ids.push_back(next->id);
+            chain_cursor = SearchCursor(*next);
+        }
+        ASSERT(none_of(sorted_chain.begin(), sorted_chain.end(), [&chain_cursor](const Document& document) {
+            return chain_cursor.IsBefore(document, SearchServer::eps);
+            }));
+        sort(paged_ids.begin(), paged_ids.end());
+        for (int i = 0; i < 12; ++i) {
+            ASSERT_EQUAL(paged_ids[i], i);
+        }
+    }
+
+    try {
+        SearchCursor::FromString("not a cursor"s);
+        ASSERT_HINT(false, "Invalid cursor must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+}
+
+
+void TestPhraseQueries() {
+    const vector<string> texts = { "white cat and curly hair"s, "curly cat with white hair"s, "hair curly dog"s, "curly and hair"s };
+    SearchServer search_server("and with"s);
+    search_server.EnablePositionalIndex();
+    ASSERT(search_server.IsPositionalIndexEnabled());
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        search_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+    }
+
+    const auto get_ids = [](const vector<Document>& documents) {
+        vector<int> ids;
+        for (const Document& document : documents) {
+            ids.push_back(document.id);
+        }
+        sort(ids.begin(), ids.end());
+        return ids;
+    };
+    // only adjacent words match, and a stop word of the phrase must be in the same place
+    ASSERT(get_ids(search_server.FindTopDocuments("\"curly hair\""s)) == vector<int>({ 0 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("\"curly and hair\""s)) == vector<int>({ 3 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("\"white cat\" dog"s)) == vector<int>({ 0 }));
+    ASSERT(search_server.FindTopDocuments("\"curly hair\" -white"s).empty());
+    ASSERT(search_server.FindTopDocuments("\"curly parrot\""s).empty());
+    ASSERT(get_ids(search_server.FindTopDocuments(execution::par, "\"curly hair\""s)) == vector<int>({ 0 }));
+    ASSERT(get_ids(search_server.FindTopDocuments(search_server.PrepareQuery("\"curly and hair\""s))) == vector<int>({ 3 }));
+    const auto batch = search_server.FindTopDocumentsBatch({ "curly hair"s, "\"curly hair\""s });
+    ASSERT(get_ids(batch[0]) == vector<int>({ 0, 1, 2, 3 }));
+    ASSERT(get_ids(batch[1]) == vector<int>({ 0 }));
+    // a single quoted word is an ordinary plus word
+    ASSERT(get_ids(search_server.FindTopDocuments("\"dog\""s)) == vector<int>({ 2 }));
+
+    for (const string& query : { "\"curly -hair\""s, "\"curly hair"s, "curly hair\""s, "\"curly \"hair\""s }) {
+        try {
+            search_server.FindTopDocuments(query);
+            ASSERT_HINT(false, query);
+        } catch (const invalid_argument&) {
+        }
+    }
+    try {
+        search_server.EnablePositionalIndex();
+        ASSERT(false);
+    } catch (const logic_error&) {
+    }
+
+    // without the positional index quotes are ordinary characters, as in the documents
+    SearchServer plain_server("and with"s);
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        plain_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+    }
+    plain_server.AddDocument(4, "say \"hi\" to the dog"s, DocumentStatus::ACTUAL, { 4 });
+    ASSERT(get_ids(plain_server.FindTopDocuments("\"hi\""s)) == vector<int>({ 4 }));
+    ASSERT(plain_server.FindTopDocuments("hi"s).empty());
+    ASSERT(get<0>(plain_server.MatchDocument("say \"hi\""s, 4)) == vector<string_view>({ "\"hi\""sv, "say"sv }));
+    ASSERT(plain_server.FindTopDocuments("\"curly hair\""s).empty());
+    // so the unmatched quotes are not rejected
+    ASSERT(get_ids(plain_server.FindTopDocuments("\"curly hair"s)) == vector<int>({ 0, 1, 2, 3 }));
+    ASSERT(get_ids(plain_server.FindTopDocuments("curly hair\""s)) == vector<int>({ 0, 1, 2, 3 }));
+    ASSERT(plain_server.FindTopDocuments("\"curly \"hair\""s).empty());
+    ASSERT(plain_server.FindTopDocuments("\""s).empty());
+    ASSERT(get_ids(plain_server.FindTopDocuments("dog -\"white"s)) == vector<int>({ 2, 4 }));
+    ASSERT_EQUAL(plain_server.GetPositionalIndexMemoryUsage(), 0u);
+
+    const size_t memory_usage = search_server.GetPositionalIndexMemoryUsage();
+    ASSERT(memory_usage > 0u);
+    search_server.RemoveDocument(0);
+    ASSERT(search_server.GetPositionalIndexMemoryUsage() < memory_usage);
+    ASSERT(search_server.FindTopDocuments("\"curly hair\""s).empty());
+
+    // closer query words make the document more relevant in spite of its rating
+    SearchServer proximity_server;
+    proximity_server.EnablePositionalIndex(1.0);
+    proximity_server.AddDocument(10, "cat dog bird fish"s, DocumentStatus::ACTUAL, { 1 });
+    proximity_server.AddDocument(11, "cat bird fish dog"s, DocumentStatus::ACTUAL, { 5 });
+    proximity_server.AddDocument(12, "parrot"s, DocumentStatus::ACTUAL, { 1 });
+    const auto documents = proximity_server.FindTopDocuments("cat dog"s);
+    ASSERT_EQUAL(documents.size(), 2u);
+    ASSERT_EQUAL(documents[0].id, 10);
+    ASSERT(abs(documents[0].relevance / documents[1].relevance - 2.0 / (1.0 + 1.0 / 3.0)) < SearchServer::eps);
+}
+
+
+void TestBm25Scorer() {
+    SearchServer search_server;
+    search_server.AddDocument(0, "cat cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(1, "cat bird"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(2, "fish"s, DocumentStatus::ACTUAL, { 3 });
+    search_server.AddDocument(3, "cat cat cat"s, DocumentStatus::BANNED, { 4 });
+
+    // the default scorer is TF-IDF
+    const auto tf_idf_documents = search_server.FindTopDocumentsScored(TfIdfScorer(), "cat dog"s);
+    const auto default_documents = search_server.FindTopDocuments("cat dog"s);
+    ASSERT_EQUAL(tf_idf_documents.size(), default_documents.size());
+    for (size_t i = 0; i < default_documents.size(); ++i) {
+        ASSERT_EQUAL(tf_idf_documents[i].id, default_documents[i].id);
+        ASSERT(abs(tf_idf_documents[i].relevance - default_documents[i].relevance) < SearchServer::eps);
+    }
+
+    // 4 documents of 9 words; "cat" is in 3 of them
+    const auto bm25 = [](double term_count, double document_length, double document_freq, double k1, double b) {
+        const double term_weight = log(1.0 + (4.0 - document_freq + 0.5) / (document_freq + 0.5));
+        return term_weight * term_count * (k1 + 1.0) / (term_count + k1 * (1.0 - b + b * document_length * 4.0 / 9.0));
+    };
+    const auto documents = search_server.FindTopDocumentsScored(Bm25Scorer(), "cat"s);
+    ASSERT_EQUAL(documents.size(), 2u);
+    ASSERT_EQUAL(documents[0].id, 0);
+    ASSERT(abs(documents[0].relevance - bm25(2, 3, 3, 1.2, 0.75)) < SearchServer::eps);
+    ASSERT(abs(documents[1].relevance - bm25(1, 2, 3, 1.2, 0.75)) < SearchServer::eps);
+
+    const auto banned_documents = search_server.FindTopDocumentsScored(Bm25Scorer(2.0, 0.0), "cat"s, DocumentStatus::BANNED);
+    ASSERT_EQUAL(banned_documents.size(), 1u);
+    ASSERT(abs(banned_documents[0].relevance - bm25(3, 3, 3, 2.0, 0.0)) < SearchServer::eps);
+
+    // the lengths of removed documents no longer count
+    search_server.RemoveDocument(3);
+    const auto documents_after_removal = search_server.FindTopDocumentsScored(Bm25Scorer(), "cat"s, [](int document_id, DocumentStatus, int) {
+        return document_id == 1;
+        });
+    ASSERT_EQUAL(documents_after_removal.size(), 1u);
+    const double term_weight = log(1.0 + 1.5 / 2.5);
+    ASSERT(abs(documents_after_removal[0].relevance - term_weight * 2.2 / (1.0 + 1.2 * (0.25 + 0.75 * 2.0 * 3.0 / 6.0))) < SearchServer::eps);
+
+    for (const auto& [k1, b] : { pair{ -1.0, 0.5 }, pair{ 1.0, 1.5 }, pair{ 1.0, -0.1 } }) {
+        try {
+            Bm25Scorer scorer(k1, b);
+            ASSERT(false);
+        } catch (const invalid_argument&) {
+        }
+    }
+}
+
+
+void TestWildcardQueries() {
+    SearchServer search_server("run"s);
+    search_server.EnableWildcardMatching();
+    ASSERT(search_server.IsWildcardMatchingEnabled());
+    search_server.AddDocument(0, "pig piglet farm"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(1, "piglets run"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(2, "pigeon flies"s, DocumentStatus::ACTUAL, { 3 });
+    search_server.AddDocument(3, "dog farm"s, DocumentStatus::ACTUAL, { 4 });
+    search_server.AddDocument(4, "big pig"s, DocumentStatus::ACTUAL, { 5 });
+
+    const auto get_ids = [](const vector<Document>& documents) {
+        vector<int> ids;
+        for (const Document& document : documents) {
+            ids.push_back(document.id);
+        }
+        sort(ids.begin(), ids.end());
+        return ids;
+    };
+    ASSERT(get_ids(search_server.FindTopDocuments("pig*"s)) == vector<int>({ 0, 1, 2, 4 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("pig*let*"s)) == vector<int>({ 0, 1 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("farm -pig*"s)) == vector<int>({ 3 }));
+    ASSERT(get_ids(search_server.FindTopDocuments(execution::par, "pig*"s)) == vector<int>({ 0, 1, 2, 4 }));
+    ASSERT(search_server.FindTopDocuments("cow*"s).empty());
+
+    // the expanded words are scored as one term found in 4 documents of 5
+    const auto documents = search_server.FindTopDocuments("pig*"s, [](int document_id, DocumentStatus, int) {
+        return document_id == 0;
+        });
+    ASSERT_EQUAL(documents.size(), 1u);
+    ASSERT(abs(documents[0].relevance - 2.0 / 3.0 * log(5.0 / 4.0)) < SearchServer::eps);
+
+    const vector<string_view> expected_words = { "pig"sv, "piglet"sv };
+    ASSERT(get<0>(search_server.MatchDocument("pig* farm*"s, 0)) == vector<string_view>({ "farm"sv, "pig"sv, "piglet"sv }));
+    ASSERT(get<0>(search_server.MatchDocument(execution::par, "pig*"s, 0)) == expected_words);
+    ASSERT(get<0>(search_server.MatchDocument(search_server.PrepareQuery("pig pig*"s), 0)) == expected_words);
+    ASSERT(get<0>(search_server.MatchDocument("farm -pig*"s, 0)).empty());
+    const auto matched_documents = search_server.MatchDocuments("pig*"s, { 0, 3 });
+    ASSERT(matched_documents.GetWords(0) == expected_words);
+    ASSERT(matched_documents.GetWords(1).empty());
+
+    const auto batch = search_server.FindTopDocumentsBatch({ "pig*"s, "farm -pig*"s });
+    ASSERT(get_ids(batch[0]) == vector<int>({ 0, 1, 2, 4 }));
+    ASSERT(get_ids(batch[1]) == vector<int>({ 3 }));
+
+    // only the most frequent words are expanded
+    const auto prepared_query = search_server.PrepareQuery("pig*"s);
+    search_server.SetWildcardExpansionLimit(1);
+    ASSERT(get_ids(search_server.FindTopDocuments("pig*"s)) == vector<int>({ 0, 4 }));
+    ASSERT(get_ids(search_server.FindTopDocuments(prepared_query)) == vector<int>({ 0, 4 }));
+
+    for (const string& query : { "*pig"s, "-*"s }) {
+        try {
+            search_server.FindTopDocuments(query);
+            ASSERT_HINT(false, query);
+        } catch (const invalid_argument&) {
+        }
+    }
+    // a phrase can't have wildcard words; without the positional index the quotes are a part of the words
+    ASSERT(search_server.FindTopDocuments("\"pig* farm\""s).empty());
+    SearchServer phrase_server;
+    phrase_server.EnablePositionalIndex();
+    phrase_server.EnableWildcardMatching();
+    try {
+        phrase_server.FindTopDocuments("\"pig* farm\""s);
+        ASSERT_HINT(false, "Wildcard word inside a phrase must be rejected"s);
+    } catch (const invalid_argument&) {
+    }
+    try {
+        search_server.SetWildcardExpansionLimit(0);
+        ASSERT(false);
+    } catch (const invalid_argument&) {
+    }
+
+    // without wildcard matching the wildcard is an ordinary character
+    SearchServer literal_server;
+    ASSERT(!literal_server.IsWildcardMatchingEnabled());
+    literal_server.AddDocument(0, "*nix c*t"s, DocumentStatus::ACTUAL, { 1 });
+    literal_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 2 });
+    ASSERT(get_ids(literal_server.FindTopDocuments("c*t"s)) == vector<int>({ 0 }));
+    ASSERT(get_ids(literal_server.FindTopDocuments("*nix"s)) == vector<int>({ 0 }));
+    ASSERT(get<0>(literal_server.MatchDocument("+c*t -*"s, 0)) == vector<string_view>({ "c*t"sv }));
+    literal_server.EnableWildcardMatching();
+    ASSERT(get_ids(literal_server.FindTopDocuments("c*t"s)) == vector<int>({ 0, 1 }));
+    literal_server.DisableWildcardMatching();
+    ASSERT(get_ids(literal_server.FindTopDocuments("c*t"s)) == vector<int>({ 0 }));
+}
+
+
+void TestFuzzyMatching() {
+    // the automaton accepts the same words as the edit distance computed directly
+    const auto edit_distance = [](const string& lhs, const string& rhs) {
+        vector<int> row(rhs.size() + 1);
+        iota(row.begin(), row.end(), 0);
+        for (size_t i = 1; i <= lhs.size(); ++i) {
+            int diagonal = row[0];
+            row[0] = static_cast<int>(i);
+            for (size_t j = 1; j <= rhs.size(); ++j) {
+                const int substitution = diagonal + (lhs[i - 1] == rhs[j - 1] ? 0 : 1);
+                diagonal = row[j];
+                row[j] = min({ substitution, row[j] + 1, row[j - 1] + 1 });
+            }
+        }
+        return row[rhs.size()];
+    };
+    mt19937 generator(42);
+    const auto make_word = [&generator]() {
+        string word(generator() % 6 + 1, 'a');
+        for (char& c : word) {
+            c = static_cast<char>('a' + generator() % 3);
+        }
+        return word;
+    };
+    map<string, int, less<>> dictionary;
+    for (int i = 0; i < 300; ++i) {
+        dictionary[make_word()] = i;
+    }
+    TermDictionary term_dictionary;
+    for (const auto& [word, _] : dictionary) {
+        term_dictionary.PushBack(word);
+    }
+    for (int i = 0; i < 50; ++i) {
+        const string word = make_word();
+        const int max_distance = i % 3;
+        const size_t prefix_length = i % 4 / 2;
+        map<string, int> accepted;
+        for (const auto& [accepted_word, distance] : term_dictionary.FindWithinDistance(LevenshteinAutomaton(word, max_distance, prefix_length))) {
+            accepted[string(accepted_word)] = distance;
+        }
+        map<string, int> expected;
+        for (const auto& [dictionary_word, _] : dictionary) {
+            const int distance = edit_distance(word, dictionary_word);
+            if (distance <= max_distance && dictionary_word.compare(0, prefix_length, word, 0, prefix_length) == 0) {
+                expected[dictionary_word] = distance;
+            }
+        }
+        ASSERT_HINT(accepted == expected, word);
+    }
+
+    SearchServer search_server("and"s);
+    search_server.AddDocument(0, "curly cat"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(1, "fluffy dog"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(2, "groomed starling"s, DocumentStatus::ACTUAL, { 3 });
+    search_server.AddDocument(3, "cats and dogs"s, DocumentStatus::ACTUAL, { 4 });
+    const auto prepared_query = search_server.PrepareQuery("kat"s);
+    ASSERT(search_server.FindTopDocuments("kat"s).empty());
+
+    const auto get_ids = [](const vector<Document>& documents) {
+        vector<int> ids;
+        for (const Document& document : documents) {
+            ids.push_back(document.id);
+        }
+        sort(ids.begin(), ids.end());
+        return ids;
+    };
+    search_server.EnableFuzzyMatching();
+    const auto documents = search_server.FindTopDocuments("kat"s);
+    ASSERT_EQUAL(documents.size(), 1u);
+    ASSERT_EQUAL(documents[0].id, 0);
+    ASSERT(abs(documents[0].relevance - 0.5 * 0.5 * log(4.0)) < SearchServer::eps);
+    ASSERT(get_ids(search_server.FindTopDocuments(prepared_query)) == vector<int>({ 0 }));
+    ASSERT(get_ids(search_server.FindTopDocuments(execution::par, "strling"s)) == vector<int>({ 2 }));
+    // "dgo" is a transposition, which takes 2 edits
+    ASSERT(get_ids(search_server.FindTopDocuments("fluffi dgo"s)) == vector<int>({ 1 }));
+    ASSERT(get_ids(search_server.FindTopDocumentsBatch({ "kat"s })[0]) == vector<int>({ 0 }));
+
+    // an exact match outranks a fuzzy one
+    const auto cat_documents = search_server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL(cat_documents.size(), 2u);
+    ASSERT_EQUAL(cat_documents[0].id, 0);
+    ASSERT_EQUAL(cat_documents[1].id, 3);
+
+    ASSERT(get<0>(search_server.MatchDocument("kat cat"s, 3)).empty());
+    ASSERT(get<0>(search_server.MatchDocument(prepared_query, 0)).empty());
+    ASSERT(search_server.MatchDocuments("kat curly"s, { 0 }).GetWords(0) == vector<string_view>({ "curly"sv }));
+
+    // 2 edits are allowed only for long words
+    ASSERT(search_server.FindTopDocuments("starlnig"s).empty());
+    search_server.EnableFuzzyMatching(2, 0.8);
+    ASSERT(get_ids(search_server.FindTopDocuments("starlnig"s)) == vector<int>({ 2 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("fluffi dgo"s)) == vector<int>({ 1 }));
+    // the second edit requires the same first character, the first one doesn't
+    ASSERT(get_ids(search_server.FindTopDocuments("ttarling"s)) == vector<int>({ 2 }));
+    ASSERT(search_server.FindTopDocuments("ttarlin"s).empty());
+    search_server.DisableFuzzyMatching();
+    ASSERT(search_server.FindTopDocuments(prepared_query).empty());
+
+    for (const auto& [distance, discount] : { pair{ 0, 0.5 }, pair{ 3, 0.5 }, pair{ 1, 0.0 }, pair{ 1, 1.5 } }) {
+        try {
+            search_server.EnableFuzzyMatching(distance, discount);
+            ASSERT(false);
+        } catch (const invalid_argument&) {
+        }
+    }
+    ASSERT_EQUAL(search_server.GetFuzzyMaxEditDistance(), 0);
+}
+
+
+void TestBooleanQueries() {
+    // the intersection equals the one of std::set_intersection, also when written over the first array
+    mt19937 generator(42);
+    for (int iteration = 0; iteration < 200; ++iteration) {
+        vector<int> lhs;
+        vector<int> rhs;
+        const int lhs_density = uniform_int_distribution<int>(1, 10)(generator);
+        const int rhs_density = uniform_int_distribution<int>(1, 10)(generator);
+        for (int value = 0; value < 300; ++value) {
+            if (uniform_int_distribution<int>(0, 9)(generator) < lhs_density) {
+                lhs.push_back(value);
+            }
+            if (uniform_int_distribution<int>(0, 9)(generator) < rhs_density) {
+                rhs.push_back(value);
+            }
+        }
+        lhs.resize(uniform_int_distribution<size_t>(0, lhs.size())(generator));
+        vector<int> expected;
+        set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), back_inserter(expected));
+        vector<int> output(min(lhs.size(), rhs.size()));
+        output.resize(IntersectSorted(lhs.data(), lhs.size(), rhs.data(), rhs.size(), output.data()));
+        ASSERT(output == expected);
+        lhs.resize(IntersectSorted(lhs.data(), lhs.size(), rhs.data(), rhs.size(), lhs.data()));
+        ASSERT(lhs == expected);
+    }
+
+    SearchServer search_server("and the"s);
+    search_server.EnableWildcardMatching();
+    search_server.AddDocument(0, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(1, "black cat and black dog"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(2, "white dog"s, DocumentStatus::ACTUAL, { 3 });
+    search_server.AddDocument(3, "white parrot"s, DocumentStatus::ACTUAL, { 4 });
+    search_server.AddDocument(4, "black parrot"s, DocumentStatus::BANNED, { 5 });
+
+    const auto get_ids = [](const vector<Document>& documents) {
+        vector<int> ids;
+        for (const Document& document : documents) {
+            ids.push_back(document.id);
+        }
+        sort(ids.begin(), ids.end());
+        return ids;
+    };
+    ASSERT(get_ids(search_server.FindTopDocuments("+white cat"s)) == vector<int>({ 0, 2, 3 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("white AND cat"s)) == vector<int>({ 0 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("white OR cat"s)) == vector<int>({ 0, 1, 2, 3 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("black AND -dog"s, DocumentStatus::BANNED)) == vector<int>({ 4 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("+(cat OR dog) white"s)) == vector<int>({ 0, 1, 2 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("+(cat dog) +black"s)) == vector<int>({ 1 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("white -(cat dog)"s)) == vector<int>({ 3 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("+wh* +(ca* OR par*)"s)) == vector<int>({ 0, 3 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("+the white"s)) == vector<int>({ 0, 2, 3 }));
+    ASSERT(search_server.FindTopDocuments("+cow white"s).empty());
+    ASSERT(get_ids(search_server.FindTopDocuments(execution::par, "white AND cat"s)) == vector<int>({ 0 }));
+    ASSERT(get_ids(search_server.FindTopDocuments(search_server.PrepareQuery("+(cat OR dog) white"s))) == vector<int>({ 0, 1, 2 }));
+
+    // the required documents are scored as without the operators
+    const auto required_documents = search_server.FindTopDocuments("+black cat"s);
+    const auto documents = search_server.FindTopDocuments("black cat"s);
+    ASSERT_EQUAL(required_documents.size(), 1u);
+    ASSERT_EQUAL(required_documents[0].id, 1);
+    ASSERT(abs(required_documents[0].relevance - documents[0].relevance) < SearchServer::eps);
+
+    const auto batch = search_server.FindTopDocumentsBatch({ "white cat"s, "white AND cat"s, "cat AND white"s });
+    ASSERT(get_ids(batch[0]) == vector<int>({ 0, 1, 2, 3 }));
+    ASSERT(get_ids(batch[1]) == vector<int>({ 0 }));
+    ASSERT(get_ids(batch[2]) == vector<int>({ 0 }));
+
+    ASSERT(get<0>(search_server.MatchDocument("+white cat"s, 1)).empty());
+    ASSERT(get<0>(search_server.MatchDocument(execution::par, "+white cat"s, 1)).empty());
+    ASSERT(get<0>(search_server.MatchDocument(search_server.PrepareQuery("+white cat"s), 1)).empty());
+    ASSERT(get<0>(search_server.MatchDocument("+white cat"s, 0)) == vector<string_view>({ "cat"sv, "white"sv }));
+    const auto matched_documents = search_server.MatchDocuments("+(cat dog) white"s, { 0, 3 });
+    ASSERT(matched_documents.GetWords(0) == vector<string_view>({ "cat"sv, "white"sv }));
+    ASSERT(matched_documents.GetWords(1).empty());
+
+    // an operator without an operand on either side and a parenthesis outside a group are ordinary characters
+    ASSERT(get_ids(search_server.FindTopDocuments("AND cat"s)) == vector<int>({ 0, 1 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("cat OR"s)) == vector<int>({ 0, 1 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("(cat OR)"s)) == vector<int>({ 0, 1 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("(OR cat)"s)) == vector<int>({ 0, 1 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("(cat AND dog)"s)) == vector<int>({ 0, 1, 2 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("cat :)"s)) == vector<int>({ 0, 1 }));
+    ASSERT(search_server.FindTopDocuments("cat)"s).empty());
+    // as well as a parenthesis that no later word closes
+    ASSERT(search_server.FindTopDocuments("(cat"s).empty());
+    ASSERT(get_ids(search_server.FindTopDocuments("cat ("s)) == vector<int>({ 0, 1 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("+(cat dog) -(white"s)) == vector<int>({ 0, 1, 2 }));
+    SearchServer word_server;
+    word_server.AddDocument(0, "rock OR roll :)"s, DocumentStatus::ACTUAL, { 1 });
+    word_server.AddDocument(1, "rock"s, DocumentStatus::ACTUAL, { 2 });
+    word_server.AddDocument(2, "(roll"s, DocumentStatus::ACTUAL, { 3 });
+    ASSERT(get_ids(word_server.FindTopDocuments("OR"s)) == vector<int>({ 0 }));
+    ASSERT(get_ids(word_server.FindTopDocuments(":)"s)) == vector<int>({ 0 }));
+    ASSERT(get_ids(word_server.FindTopDocuments("rock (roll"s)) == vector<int>({ 0, 1, 2 }));
+    ASSERT(get<0>(word_server.MatchDocument("rock OR"s, 0)) == vector<string_view>({ "OR"sv, "rock"sv }));
+    ASSERT(get<0>(word_server.MatchDocument("OR AND rock"s, 0)) == vector<string_view>({ "OR"sv, "rock"sv }));
+    ASSERT(get<0>(word_server.MatchDocument("OR AND rock"s, 1)).empty());
+
+    for (const string& query : { "+"s, "++cat"s, "(cat (dog))"s, "()"s, "(-cat dog)"s }) {
+        try {
+            search_server.FindTopDocuments(query);
+            ASSERT_HINT(false, query);
+        } catch (const invalid_argument&) {
+        }
+    }
+    // phrases are parsed only with the positional index, otherwise the quoted words are not indexed
+    SearchServer phrase_server;
+    phrase_server.EnablePositionalIndex();
+    for (const string& query : { "(\"cat dog\")"s, "\"cat +dog\""s }) {
+        ASSERT(search_server.FindTopDocuments(query).empty());
+        try {
+            phrase_server.FindTopDocuments(query);
+            ASSERT_HINT(false, query);
+        } catch (const invalid_argument&) {
+        }
+    }
+}
+
+
+void TestTextAnalyzer() {
+    const auto analyze = [](const TextAnalyzer& analyzer, string text, string_view extra_word_characters = {}) {
+        vector<string_view> words;
+        analyzer.Analyze(text.data(), text.size(), words, extra_word_characters);
+        return vector<string>(words.begin(), words.end());
+    };
+    const TextAnalyzer analyzer;
+    ASSERT(analyze(analyzer, "Cat, dog's  DOGS!\tE-mail\n"s) == vector<string>({ "cat"s, "dog"s, "s"s, "dogs"s, "e"s, "mail"s }));
+    ASSERT(analyze(analyzer, "pig* farm"s, "*"sv) == vector<string>({ "pig*"s, "farm"s }));
+    ASSERT(analyze(analyzer, "..."s).empty());
+    // Cyrillic, Greek and Latin-1 capitals are folded; no-break space and guillemets separate the words
+    ASSERT(analyze(analyzer, "\xD0\x9A\xD0\xBE\xD1\x82\xC2\xA0\xC2\xAB\xD0\xBA\xD0\xBE\xD1\x82\xC2\xBB \xCE\x91\xCE\xA9 \xC3\x89" "clair"s)
+        == vector<string>({ "\xD0\xBA\xD0\xBE\xD1\x82"s, "\xD0\xBA\xD0\xBE\xD1\x82"s, "\xCE\xB1\xCF\x89"s, "\xC3\xA9" "clair"s }));
+    ASSERT(analyze(TextAnalyzer({ true, true, true }), "Ponies heroes cats glass bus"s) == vector<string>({ "pony"s, "heroe"s, "cat"s, "glass"s, "bus"s }));
+    ASSERT(analyze(TextAnalyzer({ false, false, false }), "Cat, dog's"s) == vector<string>({ "Cat,"s, "dog's"s }));
+    for (const string& text : { "\xFF"s, "a\x01z"s, "\xC0\x80"s, "\xD0"s, "\xED\xA0\x80"s, "a\x7F"s }) {
+        try {
+            analyze(analyzer, text);
+            ASSERT_HINT(false, text);
+        } catch (const invalid_argument&) {
+        }
+    }
+
+    // words crossing the blocks of 16 bytes are split and folded like the short ones
+    const vector<pair<string, string>> pieces = { { "Word"s, "word"s }, { "x"s, "x"s }, { "LONGERWORDTHANABLOCK"s, "longerwordthanablock"s },
+        { "\xD0\x94\xD0\xBE\xD0\xBC"s, "\xD0\xB4\xD0\xBE\xD0\xBC"s }, { "a1b2"s, "a1b2"s }, { "\xE2\x82\xAC"s, "\xE2\x82\xAC"s } };
+    const vector<string> separators = { " "s, ", "s, "\t"s, " -- "s, "\xE2\x80\x94"s, "\xC2\xA0"s };
+    mt19937 generator(42);
+    for (int iteration = 0; iteration < 200; ++iteration) {
+        string text;
+        vector<string> expected;
+        const int word_count = uniform_int_distribution<int>(0, 20)(generator);
+        for (int i = 0; i < word_count; ++i) {
+            const auto& piece = pieces[uniform_int_distribution<size_t>(0, pieces.size() - 1)(generator)];
+            text += piece.first;
+            text += separators[uniform_int_distribution<size_t>(0, separators.size() - 1)(generator)];
+            expected.push_back(piece.second);
+        }
+        ASSERT_HINT(analyze(analyzer, text) == expected, text);
+    }
+
+    // without the analyzer the words are only separated by spaces and may be in any single-byte encoding
+    vector<string_view> words;
+    SplitIntoValidWordViews("  a   long enough text to fill blocks \xE0\xFF "sv, words);
+    ASSERT(words == vector<string_view>({ "a"sv, "long"sv, "enough"sv, "text"sv, "to"sv, "fill"sv, "blocks"sv, "\xE0\xFF"sv }));
+    try {
+        SplitIntoValidWordViews("a long enough text with con\x01trol"sv, words);
+        ASSERT(false);
+    } catch (const invalid_argument& e) {
+        ASSERT_EQUAL(string(e.what()), "Word con\x01trol is invalid"s);
+    }
+
+    SearchServer search_server("The"s);
+    search_server.EnablePositionalIndex();
+    search_server.EnableTextAnalyzer({ true, true, true });
+    search_server.EnableWildcardMatching();
+    ASSERT(search_server.IsTextAnalyzerEnabled());
+    search_server.AddDocument(0, "The Cat sat on the mat."s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(1, "Ponies, cats and dogs!"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(2, "\xD0\x9A\xD0\xBE\xD1\x82 \xD0\xB8 \xD0\xBF\xD1\x91\xD1\x81"s, DocumentStatus::ACTUAL, { 3 });
+
+    const auto get_ids = [](const vector<Document>& documents) {
+        vector<int> ids;
+        for (const Document& document : documents) {
+            ids.push_back(document.id);
+        }
+        sort(ids.begin(), ids.end());
+        return ids;
+    };
+    ASSERT(get_ids(search_server.FindTopDocuments("CATS"s)) == vector<int>({ 0, 1 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("pony, -Cat"s)) == vector<int>({}));
+    ASSERT(get_ids(search_server.FindTopDocuments("+(Pony OR Dog) cat"s)) == vector<int>({ 1 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("\"the cat sat\""s)) == vector<int>({ 0 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("Ma*"s)) == vector<int>({ 0 }));
+    ASSERT(get_ids(search_server.FindTopDocuments("\xD0\xBA\xD0\xBE\xD1\x82"s)) == vector<int>({ 2 }));
+    ASSERT(get_ids(search_server.FindTopDocuments(search_server.PrepareQuery("Dogs"s))) == vector<int>({ 1 }));
+    ASSERT(get<0>(search_server.MatchDocument("THE CAT"s, 0)) == vector<string_view>({ "cat"sv }));
+
+    for (const string& query : { "cat\xFF"s, "*cat"s, "--cat"s }) {
+        try {
+            search_server.FindTopDocuments(query);
+            ASSERT_HINT(false, query);
+        } catch (const invalid_argument&) {
+        }
+    }
+    try {
+        search_server.AddDocument(3, "bad \xC3"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT(false);
+    } catch (const invalid_argument&) {
+    }
+    try {
+        search_server.EnableTextAnalyzer();
+        ASSERT(false);
+    } catch (const logic_error&) {
+    }
+}
+
+
+void TestLogDuration() {
+    // the guard owns its id, so it may be built from a temporary
+    ostringstream output;
+    auto* const old_buffer = cerr.rdbuf(output.rdbuf());
+    {
+        const string name = "Operation"s;
+        LOG_DURATION(name + " with a temporary id"s);
+    }
+    cerr.rdbuf(old_buffer);
+    ASSERT_EQUAL(output.str().rfind("Operation with a temporary id: "s, 0), 0u);
+}
+
+
+void TestPreparedQuerySettings() {
+    const auto get_ids = [](const vector<Document>& documents) {
+        vector<int> ids;
+        for (const Document& document : documents) {
+            ids.push_back(document.id);
+        }
+        sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    // the query prepared before the analyzer is enabled is analyzed like the raw query
+    {
+        SearchServer search_server(""s);
+        const auto prepared_query = search_server.PrepareQuery("Dogs"s);
+        search_server.EnableTextAnalyzer({ true, true, true });
+        search_server.AddDocument(1, "white dog"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT(get_ids(search_server.FindTopDocuments("Dogs"s)) == vector<int>({ 1 }));
+        ASSERT(get_ids(search_server.FindTopDocuments(prepared_query)) == vector<int>({ 1 }));
+        ASSERT(get<0>(search_server.MatchDocument(prepared_query, 1)) == vector<string_view>({ "dog"sv }));
+    }
+
+    // the query prepared before the positional index is enabled is a phrase like the raw query
+    {
+        SearchServer search_server(""s);
+        const auto prepared_query = search_server.PrepareQuery("\"cat dog\""s);
+        search_server.EnablePositionalIndex();
+        search_server.AddDocument(1, "dog and cat"s, DocumentStatus::ACTUAL, { 1 });
+        search_server.AddDocument(2, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT(get_ids(search_server.FindTopDocuments("\"cat dog\""s)) == vector<int>({ 2 }));
+        ASSERT(get_ids(search_server.FindTopDocuments(prepared_query)) == vector<int>({ 2 }));
+    }
+
+    // a copy made before the settings change is parsed again as well
+    {
+        SearchServer search_server(""s);
+        search_server.AddDocument(1, "pig farm"s, DocumentStatus::ACTUAL, { 1 });
+        const auto prepared_query = search_server.PrepareQuery("pi*"s);
+        const auto copy = prepared_query;
+        ASSERT(search_server.FindTopDocuments(copy).empty());
+        search_server.EnableWildcardMatching();
+        ASSERT(get_ids(search_server.FindTopDocuments(copy)) == vector<int>({ 1 }));
+        ASSERT(get_ids(search_server.FindTopDocuments(prepared_query)) == vector<int>({ 1 }));
+        search_server.DisableWildcardMatching();
+        ASSERT(search_server.FindTopDocuments(prepared_query).empty());
+    }
+}
+
+
 void TestSearchServer() {
     RUN_TEST(TestSearchAddedDocument);
     RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
@@ -1169,4 +2704,30 @@ void TestSearchServer() {
     RUN_TEST(TestParallelMatchDocument);
     RUN_TEST(TestParallelFindTopDocuments);
     RUN_TEST(TestFindTopDocumentsSpeed);
+    RUN_TEST(TestProcessQueriesBatch);
+    RUN_TEST(TestSubmitFindTopDocuments);
+    RUN_TEST(TestResultCache);
+    RUN_TEST(TestPreparedQuery);
+    RUN_TEST(TestQueryParsing);
+    RUN_TEST(TestQueryArena);
+    RUN_TEST(TestMatchDocumentConcurrency);
+    RUN_TEST(TestMatchDocuments);
+    RUN_TEST(TestRemoveDuplicatesByFingerprint);
+    RUN_TEST(TestFindNearDuplicates);
+    RUN_TEST(TestDuplicatePolicy);
+    RUN_TEST(TestConcurrentRequestQueue);
+    RUN_TEST(TestRequestStatistics);
+    RUN_TEST(TestProfiler);
+    RUN_TEST(TestTracer);
+    RUN_TEST(TestWorkloadCapture);
+    RUN_TEST(TestLazyPaginator);
+    RUN_TEST(TestFindTopDocumentsPage);
+    RUN_TEST(TestPhraseQueries);
+    RUN_TEST(TestBm25Scorer);
+    RUN_TEST(TestWildcardQueries);
+    RUN_TEST(TestFuzzyMatching);
+    RUN_TEST(TestBooleanQueries);
+    RUN_TEST(TestTextAnalyzer);
+    RUN_TEST(TestLogDuration);
+    RUN_TEST(TestPreparedQuerySettings);
 }
\ No newline at end of file
@@ -77,4 +77,30 @@ void TestProcessQueriesJoined();
 void TestParallelMatchDocument();
 void TestParallelFindTopDocuments();
 void TestFindTopDocumentsSpeed();
+void TestProcessQueriesBatch();
+void TestSubmitFindTopDocuments();
+void TestResultCache();
+void TestPreparedQuery();
+void TestQueryParsing();
+void TestQueryArena();
+void TestMatchDocumentConcurrency();
+void TestMatchDocuments();
+void TestRemoveDuplicatesByFingerprint();
+void TestFindNearDuplicates();
+void TestDuplicatePolicy();
+void TestConcurrentRequestQueue();
+void TestRequestStatistics();
+void TestProfiler();
+void TestTracer();
+void TestWorkloadCapture();
+void TestLazyPaginator();
+void TestFindTopDocumentsPage();
+void TestPhraseQueries();
+void TestBm25Scorer();
+void TestWildcardQueries();
+void TestFuzzyMatching();
+void TestBooleanQueries();
+void TestTextAnalyzer();
+void TestLogDuration();
+void TestPreparedQuerySettings();
 void TestSearchServer();
\ No newline at end of file
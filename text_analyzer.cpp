@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "text_analyzer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SEARCH_SERVER_HAS_SSE2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 16;
+
+
+[[maybe_unused]] int CountTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+
+// Calls on_word(begin, end) for every run of word characters of the text. classify_block(position, word_mask)
+// sets the bits of the word bytes of the block at the position, or returns false if its characters have to be
+// classified one by one: classify_character(position) returns the length of the character and whether it is
+// a part of a word.
+template <typename BlockClassifier, typename CharacterClassifier, typename OnWord>
+void ScanWords(size_t size, [[maybe_unused]] BlockClassifier classify_block, CharacterClassifier classify_character, OnWord on_word) {
+    size_t word_begin = 0;
+    bool is_in_word = false;
+    const auto set_is_in_word = [&](size_t position, bool is_word) {
+        if (is_word == is_in_word) {
+            return;
+        }
+        if (is_word) {
+            word_begin = position;
+        } else {
+            on_word(word_begin, position);
+        }
+        is_in_word = is_word;
+    };
+
+    size_t position = 0;
+#ifdef SEARCH_SERVER_HAS_SSE2
+    while (position + BLOCK_SIZE <= size) {
+        uint32_t word_mask = 0;
+        if (!classify_block(position, word_mask)) {
+            // The last character may end after the block
+            const size_t block_end = position + BLOCK_SIZE;
+            while (position < block_end) {
+                const auto [length, is_word] = classify_character(position);
+                set_is_in_word(position, is_word);
+                position += length;
+            }
+            continue;
+        }
+        // The bits of the bytes where a word starts or ends
+        uint32_t boundaries = (word_mask ^ ((word_mask << 1) | (is_in_word ? 1u : 0u))) & 0xFFFFu;
+        while (boundaries != 0) {
+            set_is_in_word(position + CountTrailingZeros(boundaries), !is_in_word);
+            boundaries &= boundaries - 1;
+        }
+        position += BLOCK_SIZE;
+    }
+#endif
+    while (position < size) {
+        const auto [length, is_word] = classify_character(position);
+        set_is_in_word(position, is_word);
+        position += length;
+    }
+    set_is_in_word(size, false);
+}
+
+
+bool IsControlCharacter(char c) {
+    return (c >= '\0' && c < ' ') || c == '\x7f';
+}
+
+
+bool IsAsciiWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+
+bool IsAsciiWordCharacter(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+
+bool IsUnicodeWhitespace(char32_t c) {
+    return c == 0x85 || c == 0xA0 || c == 0x1680 || (c >= 0x2000 && c <= 0x200A) || c == 0x2028 || c == 0x2029
+        || c == 0x202F || c == 0x205F || c == 0x3000;
+}
+
+
+// Punctuation and symbols above ASCII
+bool IsUnicodePunctuation(char32_t c) {
+    switch (c) {
+    case 0xA1: case 0xA7: case 0xAB: case 0xB6: case 0xB7: case 0xBB: case 0xBF: case 0xD7: case 0xF7: case 0xFEFF:
+        return true;
+    default:
+        // General Punctuation, Supplemental Punctuation, CJK Symbols and Punctuation
+        return (c >= 0x2000 && c <= 0x206F) || (c >= 0x2E00 && c <= 0x2E7F) || (c >= 0x3000 && c <= 0x303F);
+    }
+}
+
+
+// The folded letters are encoded by two bytes just like the capital ones
+char32_t FoldCase(char32_t c) {
+    if ((c >= 0xC0 && c <= 0xDE && c != 0xD7) || (c >= 0x391 && c <= 0x3A9 && c != 0x3A2) || (c >= 0x410 && c <= 0x42F)) {
+        return c + 0x20;
+    }
+    if (c >= 0x400 && c <= 0x40F) {
+        return c + 0x50;
+    }
+    return c;
+}
+
+
+// Decodes the character starting at the position; throws std::invalid_argument for malformed,
+// overlong and surrogate sequences
+std::pair<char32_t, size_t> DecodeUtf8(const char* text, size_t size, size_t position) {
+    using namespace std::string_literals;
+    const auto byte = [text](size_t index) {
+        return static_cast<unsigned char>(text[index]);
+    };
+    const unsigned char lead = byte(position);
+    size_t length = 0;
+    char32_t c = 0;
+    char32_t min_value = 0;
+    if (lead < 0x80) {
+        return { lead, 1 };
+    } else if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+        c = lead & 0x1F;
+        min_value = 0x80;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        c = lead & 0x0F;
+        min_value = 0x800;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        c = lead & 0x07;
+        min_value = 0x10000;
+    } else {
+        throw std::invalid_argument("Text is not valid UTF-8"s);
+    }
+    if (position + length > size) {
+        throw std::invalid_argument("Text is not valid UTF-8"s);
+    }
+    for (size_t i = 1; i < length; ++i) {
+        if ((byte(position + i) & 0xC0) != 0x80) {
+            throw std::invalid_argument("Text is not valid UTF-8"s);
+        }
+        c = (c << 6) | (byte(position + i) & 0x3F);
+    }
+    if (c < min_value || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+        throw std::invalid_argument("Text is not valid UTF-8"s);
+    }
+    return { c, length };
+}
+
+
+bool EndsWith(std::string_view word, std::string_view suffix) {
+    return word.size() >= suffix.size() && word.substr(word.size() - suffix.size()) == suffix;
+}
+
+
+// Harman's S-stemmer: "-ies" becomes "-y", "-es" becomes "-e" and "-s" is dropped, except after some letters
+size_t StemWord(char* word, size_t size) {
+    const std::string_view view(word, size);
+    if (size <= 3) {
+        return size;
+    }
+    if (EndsWith(view, "ies") && !EndsWith(view, "eies") && !EndsWith(view, "aies")) {
+        word[size - 3] = 'y';
+        return size - 2;
+    }
+    if (EndsWith(view, "es") && !EndsWith(view, "aes") && !EndsWith(view, "ees") && !EndsWith(view, "oes")) {
+        return size - 1;
+    }
+    if (EndsWith(view, "s") && !EndsWith(view, "us") && !EndsWith(view, "ss")) {
+        return size - 1;
+    }
+    return size;
+}
+
+}  // namespace
+
+
+TextAnalyzer::TextAnalyzer(const AnalyzerOptions& options)
+    : options_(options)
+{
+}
+
+
+void TextAnalyzer::Analyze(char* text, size_t size, std::vector<std::string_view>& words, std::string_view extra_word_characters) const {
+    using namespace std::string_literals;
+    const auto is_word_character = [this, extra_word_characters](char c) {
+        if (!options_.split_on_punctuation) {
+            return !IsAsciiWhitespace(c);
+        }
+        return IsAsciiWordCharacter(c) || extra_word_characters.find(c) != std::string_view::npos;
+    };
+
+    const auto classify_block = [&]([[maybe_unused]] size_t position, [[maybe_unused]] uint32_t& word_mask) {
+#ifdef SEARCH_SERVER_HAS_SSE2
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + position));
+        // Bytes from 0x80 are negative, so the comparison with ' ' catches them as well as the control characters
+        const __m128i special = _mm_or_si128(_mm_cmplt_epi8(bytes, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\x7f')));
+        if (_mm_movemask_epi8(special) != 0) {
+            return false;
+        }
+        const auto in_range = [](__m128i values, char low, char high) {
+            return _mm_and_si128(_mm_cmpgt_epi8(values, _mm_set1_epi8(static_cast<char>(low - 1))), _mm_cmplt_epi8(values, _mm_set1_epi8(static_cast<char>(high + 1))));
+        };
+        __m128i word_bytes;
+        if (options_.split_on_punctuation) {
+            word_bytes = _mm_or_si128(in_range(bytes, '0', '9'), in_range(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z'));
+            for (const char c : extra_word_characters) {
+                word_bytes = _mm_or_si128(word_bytes, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(c)));
+            }
+        } else {
+            word_bytes = _mm_xor_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')), _mm_set1_epi8(-1));
+        }
+        if (options_.fold_case) {
+            const __m128i capitals = in_range(bytes, 'A', 'Z');
+            if (_mm_movemask_epi8(capitals) != 0) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(text + position), _mm_add_epi8(bytes, _mm_and_si128(capitals, _mm_set1_epi8(0x20))));
+            }
+        }
+        word_mask = static_cast<uint32_t>(_mm_movemask_epi8(word_bytes));
+        return true;
+#else
+        return false;
+#endif
+    };
+
+    const auto classify_character = [&](size_t position) -> std::pair<size_t, bool> {
+        const char c = text[position];
+        if (static_cast<unsigned char>(c) < 0x80) {
+            if (IsControlCharacter(c) && !IsAsciiWhitespace(c)) {
+                throw std::invalid_argument("Text contains a control character"s);
+            }
+            if (options_.fold_case && c >= 'A' && c <= 'Z') {
+                text[position] = static_cast<char>(c + ('a' - 'A'));
+            }
+            return { 1, is_word_character(c) };
+        }
+        const auto [code_point, length] = DecodeUtf8(text, size, position);
+        if (options_.fold_case && length == 2) {
+            const char32_t folded = FoldCase(code_point);
+            if (folded != code_point) {
+                text[position] = static_cast<char>(0xC0 | (folded >> 6));
+                text[position + 1] = static_cast<char>(0x80 | (folded & 0x3F));
+            }
+        }
+        return { length, !IsUnicodeWhitespace(code_point) && !(options_.split_on_punctuation && IsUnicodePunctuation(code_point)) };
+    };
+
+    ScanWords(size, classify_block, classify_character, [&](size_t begin, size_t end) {
+        const size_t word_size = options_.stem ? StemWord(text + begin, end - begin) : end - begin;
+        words.emplace_back(text + begin, word_size);
+        });
+}
+
+
+const AnalyzerOptions& TextAnalyzer::GetOptions() const {
+    return options_;
+}
+
+
+void SplitIntoValidWordViews(std::string_view text, std::vector<std::string_view>& words) {
+    using namespace std::string_literals;
+    const auto throw_invalid_word = [text](size_t position) {
+        const size_t word_begin = text.rfind(' ', position) + 1;
+        const size_t word_end = std::min(text.find(' ', position), text.size());
+        throw std::invalid_argument("Word "s + std::string(text.substr(word_begin, word_end - word_begin)) + " is invalid"s);
+    };
+
+    const auto classify_block = [text]([[maybe_unused]] size_t position, [[maybe_unused]] uint32_t& word_mask) {
+#ifdef SEARCH_SERVER_HAS_SSE2
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + position));
+        const __m128i controls = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(-1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8(' ')));
+        if (_mm_movemask_epi8(controls) != 0) {
+            return false;
+        }
+        word_mask = static_cast<uint32_t>(~_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')))) & 0xFFFFu;
+        return true;
+#else
+        return false;
+#endif
+    };
+
+    const auto classify_character = [text, &throw_invalid_word](size_t position) -> std::pair<size_t, bool> {
+        const char c = text[position];
+        if (c >= '\0' && c < ' ') {
+            throw_invalid_word(position);
+        }
+        return { 1, c != ' ' };
+    };
+
+    ScanWords(text.size(), classify_block, classify_character, [text, &words](size_t begin, size_t end) {
+        words.push_back(text.substr(begin, end - begin));
+        });
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+
+struct AnalyzerOptions {
+    // Words are separated by any Unicode whitespace and by punctuation, not only by spaces
+    bool split_on_punctuation = true;
+    // Capital Latin, Latin-1, Greek and Cyrillic letters are replaced by the small ones
+    bool fold_case = true;
+    // English plurals are reduced to the singular by the S-stemmer ("ponies" -> "pony")
+    bool stem = false;
+};
+
+
+// Splits UTF-8 texts into normalized words. The text is classified 16 bytes at a time with SSE2
+// where it is available; only the blocks with non-ASCII or control characters are decoded one
+// character at a time. A normalized word is never longer than its text.
+class TextAnalyzer {
+public:
+    explicit TextAnalyzer(const AnalyzerOptions& options = AnalyzerOptions());
+
+
+    // Normalizes the words of the text in place and appends them to words; the words refer to the text.
+    // The characters of extra_word_characters are parts of the words. Throws std::invalid_argument
+    // if the text is not valid UTF-8 or contains control characters other than whitespace.
+    void Analyze(char* text, size_t size, std::vector<std::string_view>& words, std::string_view extra_word_characters = {}) const;
+
+
+    const AnalyzerOptions& GetOptions() const;
+
+private:
+    AnalyzerOptions options_;
+};
+
+
+// Appends the words of the text separated by spaces to words without normalizing them; the text
+// may be in any single-byte encoding. Throws std::invalid_argument if a word has a control character.
+void SplitIntoValidWordViews(std::string_view text, std::vector<std::string_view>& words);
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <string_view>
+
+#include "trace.h"
+
+
+namespace {
+
+// Exactly, without the precision loss of a double in a stream
+void WriteMicroseconds(std::ostream& output, uint64_t nanoseconds) {
+    const uint64_t fraction = nanoseconds % 1000;
+    output << nanoseconds / 1000 << '.' << fraction / 100 << fraction / 10 % 10 << fraction % 10;
+}
+
+}  // namespace
+
+
+struct Tracer::Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<const ThreadBuffer>> thread_buffers;
+    uint32_t next_thread_index = 1;
+    // Timestamps of the trace are counted from the first use of the tracer
+    const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+};
+
+
+Tracer::Span::Span(const char* name, bool is_operation)
+    : name_(name)
+{
+    const uint32_t sampling_rate = sampling_rate_.load(std::memory_order_relaxed);
+    if (recorded_depth_ > 0) {
+        is_recorded_ = true;
+    } else if (is_operation && sampling_rate > 0) {
+        is_recorded_ = ++operation_count_ % sampling_rate == 0;
+    }
+    if (is_recorded_) {
+        ++recorded_depth_;
+        start_time_ = std::chrono::steady_clock::now();
+    }
+}
+
+
+Tracer::Span::~Span() {
+    if (is_recorded_) {
+        WriteEvent(ForCurrentThread(), name_, start_time_, std::chrono::steady_clock::now());
+        --recorded_depth_;
+    }
+}
+
+
+void Tracer::SetSamplingRate(uint32_t one_in_n) {
+    sampling_rate_.store(one_in_n, std::memory_order_relaxed);
+}
+
+
+uint32_t Tracer::GetSamplingRate() {
+    return sampling_rate_.load(std::memory_order_relaxed);
+}
+
+
+void Tracer::WriteChromeTrace(std::ostream& output) {
+    using namespace std::string_literals;
+    Registry& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    output << "{\"traceEvents\":["s;
+    bool is_first = true;
+    for (const auto& buffer : registry.thread_buffers) {
+        const uint64_t event_count = buffer->event_count.load(std::memory_order_acquire);
+        const uint64_t first_event = event_count > RING_CAPACITY ? event_count - RING_CAPACITY : 0;
+        for (uint64_t i = first_event; i < event_count; ++i) {
+            const Event& event = buffer->events[i % RING_CAPACITY];
+            const uint64_t sequence = event.sequence.load(std::memory_order_acquire);
+            const char* name = event.name.load(std::memory_order_relaxed);
+            const uint64_t start_ns = event.start_ns.load(std::memory_order_relaxed);
+            const uint64_t duration_ns = event.duration_ns.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence != 2 * i + 2 || event.sequence.load(std::memory_order_relaxed) != sequence) {
+                continue;
+            }
+
+            output << (is_first ? ""s : ","s) << "\n{\"name\":\""s;
+            for (const char c : std::string_view(name)) {
+                if (c == '"' || c == '\\') {
+                    output << '\\';
+                }
+                output << c;
+            }
+            output << "\",\"cat\":\"search_server\",\"ph\":\"X\",\"ts\":"s;
+            WriteMicroseconds(output, start_ns);
+            output << ",\"dur\":"s;
+            WriteMicroseconds(output, duration_ns);
+            output << ",\"pid\":1,\"tid\":"s << buffer->thread_index << "}"s;
+            is_first = false;
+        }
+    }
+    output << "\n]}\n"s;
+}
+
+
+size_t Tracer::ReleaseFinishedThreads() {
+    Registry& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    // The buffer of a running thread is shared with its thread_local pointer
+    const auto finished_begin = std::remove_if(registry.thread_buffers.begin(), registry.thread_buffers.end(), [](const auto& buffer) {
+        return buffer.use_count() == 1;
+        });
+    const size_t finished_count = registry.thread_buffers.end() - finished_begin;
+    registry.thread_buffers.erase(finished_begin, registry.thread_buffers.end());
+    return finished_count;
+}
+
+
+Tracer::ThreadBuffer::ThreadBuffer(uint32_t thread_index)
+    : thread_index(thread_index)
+{
+}
+
+
+Tracer::Registry& Tracer::GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+
+Tracer::ThreadBuffer& Tracer::ForCurrentThread() {
+    // The registry shares the buffers, so the spans of finished threads stay in the trace
+    // until ReleaseFinishedThreads
+    thread_local const std::shared_ptr<ThreadBuffer> thread_buffer = []() {
+        Registry& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        auto buffer = std::make_shared<ThreadBuffer>(registry.next_thread_index++);
+        registry.thread_buffers.push_back(buffer);
+        return buffer;
+    }();
+    return *thread_buffer;
+}
+
+
+void Tracer::WriteEvent(ThreadBuffer& buffer, const char* name, std::chrono::steady_clock::time_point start_time, std::chrono::steady_clock::time_point end_time) {
+    using namespace std::chrono;
+    const steady_clock::time_point trace_start_time = GetRegistry().start_time;
+    const uint64_t index = buffer.event_count.load(std::memory_order_relaxed);
+    Event& event = buffer.events[index % RING_CAPACITY];
+    event.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.start_ns.store(duration_cast<nanoseconds>(start_time - trace_start_time).count(), std::memory_order_relaxed);
+    event.duration_ns.store(duration_cast<nanoseconds>(end_time - start_time).count(), std::memory_order_relaxed);
+    event.sequence.store(2 * index + 2, std::memory_order_release);
+    buffer.event_count.store(index + 1, std::memory_order_release);
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "log_duration.h"
+
+
+// TRACE_OPERATION("name") starts a trace of a top-level operation if the operation is sampled
+// (see Tracer::SetSamplingRate); TRACE_SPAN("name") marks a stage and is recorded only inside
+// a sampled operation of the same thread. The names must be string literals.
+// Defining SEARCH_SERVER_DISABLE_TRACING removes the spans entirely.
+#ifdef SEARCH_SERVER_DISABLE_TRACING
+#define TRACE_OPERATION(name)
+#define TRACE_SPAN(name)
+#else
+#define TRACE_OPERATION(name) Tracer::Span PROFILE_CONCAT(traceSpan, __LINE__)(name, true)
+#define TRACE_SPAN(name) Tracer::Span PROFILE_CONCAT(traceSpan, __LINE__)(name, false)
+#endif
+
+
+// Every thread writes the finished spans to its own ring buffer, which keeps the last RING_CAPACITY spans.
+// The buffer is allocated by the first recorded span of the thread.
+class Tracer {
+public:
+    inline static constexpr size_t RING_CAPACITY = 4096;
+
+
+    class Span {
+    public:
+        Span(const char* name, bool is_operation);
+
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+
+        ~Span();
+
+    private:
+        const char* const name_;
+        bool is_recorded_ = false;
+        std::chrono::steady_clock::time_point start_time_;
+    };
+
+
+    // Every one_in_n-th operation of each thread is traced; 0 (the default) disables tracing
+    static void SetSamplingRate(uint32_t one_in_n);
+
+
+    static uint32_t GetSamplingRate();
+
+
+    // Writes the spans of all threads in the Chrome/Perfetto trace-event format
+    static void WriteChromeTrace(std::ostream& output);
+
+
+    // Frees the buffers of the finished threads together with their spans; returns the number of the freed buffers
+    static size_t ReleaseFinishedThreads();
+
+private:
+    // The sequence is odd while the event is being written, so a reader can skip a torn event
+    struct Event {
+        std::atomic<uint64_t> sequence{ 0 };
+        std::atomic<const char*> name{ nullptr };
+        std::atomic<uint64_t> start_ns{ 0 };
+        std::atomic<uint64_t> duration_ns{ 0 };
+    };
+
+
+    struct ThreadBuffer {
+        explicit ThreadBuffer(uint32_t thread_index);
+
+
+        const uint32_t thread_index;
+        std::atomic<uint64_t> event_count{ 0 };
+        std::array<Event, RING_CAPACITY> events;
+    };
+
+
+    struct Registry;
+
+
+    static Registry& GetRegistry();
+
+
+    static ThreadBuffer& ForCurrentThread();
+
+
+    static void WriteEvent(ThreadBuffer& buffer, const char* name, std::chrono::steady_clock::time_point start_time, std::chrono::steady_clock::time_point end_time);
+
+
+    inline static std::atomic<uint32_t> sampling_rate_{ 0 };
+    // Kept outside of the buffer, so the threads that record nothing do not allocate it
+    inline static thread_local uint64_t operation_count_ = 0;
+    inline static thread_local int recorded_depth_ = 0;
+};
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include <stdexcept>
+
+#include "workload_log.h"
+
+
+namespace {
+
+constexpr std::string_view WORKLOAD_LOG_MAGIC = "SSWL";
+constexpr uint8_t WORKLOAD_LOG_VERSION = 1;
+// Protects the reader from allocating memory for a corrupted size
+constexpr uint64_t MAX_STRING_SIZE = uint64_t{ 1 } << 30;
+
+}  // namespace
+
+
+WorkloadRecorder::WorkloadRecorder(std::ostream& output)
+    : output_(output)
+{
+    output_.write(WORKLOAD_LOG_MAGIC.data(), WORKLOAD_LOG_MAGIC.size());
+    output_.put(static_cast<char>(WORKLOAD_LOG_VERSION));
+}
+
+
+void WorkloadRecorder::RecordStopWords(std::string_view stop_words) {
+    std::lock_guard guard(mutex_);
+    WriteOperationHeader(WorkloadOperationType::SET_STOP_WORDS);
+    WriteString(stop_words);
+}
+
+
+void WorkloadRecorder::RecordAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    std::lock_guard guard(mutex_);
+    WriteOperationHeader(WorkloadOperationType::ADD_DOCUMENT);
+    WriteSigned(document_id);
+    WriteUnsigned(static_cast<uint64_t>(status));
+    WriteUnsigned(ratings.size());
+    for (const int rating : ratings) {
+        WriteSigned(rating);
+    }
+    WriteString(document);
+}
+
+
+void WorkloadRecorder::RecordRemoveDocument(int document_id) {
+    std::lock_guard guard(mutex_);
+    WriteOperationHeader(WorkloadOperationType::REMOVE_DOCUMENT);
+    WriteSigned(document_id);
+}
+
+
+void WorkloadRecorder::RecordFindTopDocuments(std::string_view raw_query, DocumentStatus status, bool has_custom_predicate) {
+    std::lock_guard guard(mutex_);
+    WriteOperationHeader(WorkloadOperationType::FIND_TOP_DOCUMENTS);
+    WriteUnsigned(static_cast<uint64_t>(status) * 2 + (has_custom_predicate ? 1 : 0));
+    WriteString(raw_query);
+}
+
+
+size_t WorkloadRecorder::GetOperationCount() const {
+    std::lock_guard guard(mutex_);
+    return operation_count_;
+}
+
+
+void WorkloadRecorder::WriteOperationHeader(WorkloadOperationType type) {
+    // The timestamp is taken under the lock, so the deltas are never negative
+    const auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time_);
+    output_.put(static_cast<char>(type));
+    WriteUnsigned((timestamp - last_timestamp_).count());
+    last_timestamp_ = timestamp;
+    ++operation_count_;
+}
+
+
+void WorkloadRecorder::WriteUnsigned(uint64_t value) {
+    while (value >= 0x80) {
+        output_.put(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    output_.put(static_cast<char>(value));
+}
+
+
+void WorkloadRecorder::WriteSigned(int64_t value) {
+    // Zigzag encoding keeps small negative numbers short
+    WriteUnsigned((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+
+void WorkloadRecorder::WriteString(std::string_view text) {
+    WriteUnsigned(text.size());
+    output_.write(text.data(), text.size());
+}
+
+
+WorkloadReader::WorkloadReader(std::istream& input)
+    : input_(input)
+{
+    using namespace std::string_literals;
+    std::string magic(WORKLOAD_LOG_MAGIC.size(), '\0');
+    input_.read(magic.data(), magic.size());
+    const int version = input_.get();
+    if (!input_ || magic != WORKLOAD_LOG_MAGIC || version != WORKLOAD_LOG_VERSION) {
+        throw std::runtime_error("Not a workload log or unsupported version"s);
+    }
+}
+
+
+std::optional<WorkloadOperation> WorkloadReader::ReadNext() {
+    using namespace std::string_literals;
+    const int type = input_.get();
+    if (type == std::char_traits<char>::eof()) {
+        return std::nullopt;
+    }
+
+    WorkloadOperation operation;
+    operation.type = static_cast<WorkloadOperationType>(type);
+    last_timestamp_ += std::chrono::nanoseconds(ReadUnsigned());
+    operation.timestamp = last_timestamp_;
+    switch (operation.type) {
+    case WorkloadOperationType::SET_STOP_WORDS:
+        operation.text = ReadString();
+        break;
+    case WorkloadOperationType::ADD_DOCUMENT: {
+        operation.document_id = static_cast<int>(ReadSigned());
+        operation.status = static_cast<DocumentStatus>(ReadUnsigned());
+        const uint64_t rating_count = ReadUnsigned();
+        for (uint64_t i = 0; i < rating_count; ++i) {
+            operation.ratings.push_back(static_cast<int>(ReadSigned()));
+        }
+        operation.text = ReadString();
+        break;
+    }
+    case WorkloadOperationType::REMOVE_DOCUMENT:
+        operation.document_id = static_cast<int>(ReadSigned());
+        break;
+    case WorkloadOperationType::FIND_TOP_DOCUMENTS: {
+        const uint64_t flags = ReadUnsigned();
+        operation.status = static_cast<DocumentStatus>(flags / 2);
+        operation.has_custom_predicate = flags % 2 == 1;
+        operation.text = ReadString();
+        break;
+    }
+    default:
+        throw std::runtime_error("Unknown operation in the workload log"s);
+    }
+    return operation;
+}
+
+
+uint64_t WorkloadReader::ReadUnsigned() {
+    using namespace std::string_literals;
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const int byte = input_.get();
+        if (byte == std::char_traits<char>::eof()) {
+            throw std::runtime_error("Workload log is truncated"s);
+        }
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Invalid varint in the workload log"s);
+}
+
+
+int64_t WorkloadReader::ReadSigned() {
+    const uint64_t value = ReadUnsigned();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+
+std::string WorkloadReader::ReadString() {
+    using namespace std::string_literals;
+    const uint64_t size = ReadUnsigned();
+    if (size > MAX_STRING_SIZE) {
+        throw std::runtime_error("Invalid string size in the workload log"s);
+    }
+    std::string text(size, '\0');
+    input_.read(text.data(), text.size());
+    if (!input_) {
+        throw std::runtime_error("Workload log is truncated"s);
+    }
+    return text;
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+
+enum class WorkloadOperationType : uint8_t {
+    SET_STOP_WORDS = 1,
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+    FIND_TOP_DOCUMENTS
+};
+
+
+struct WorkloadOperation {
+    WorkloadOperationType type = WorkloadOperationType::FIND_TOP_DOCUMENTS;
+    // Since the start of the recording
+    std::chrono::nanoseconds timestamp{ 0 };
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    // A predicate can't be recorded, so such a request is replayed with the status
+    bool has_custom_predicate = false;
+    // Stop words, the document or the query
+    std::string text;
+    std::vector<int> ratings;
+};
+
+
+// Writes the stream of operations to a compact binary log: a header, then for every operation its type,
+// the time since the previous operation and its fields, with the integers encoded as varints.
+// Thread-safe; the operations are written in the order of their timestamps.
+class WorkloadRecorder {
+public:
+    explicit WorkloadRecorder(std::ostream& output);
+
+
+    void RecordStopWords(std::string_view stop_words);
+
+
+    void RecordAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+
+    void RecordRemoveDocument(int document_id);
+
+
+    void RecordFindTopDocuments(std::string_view raw_query, DocumentStatus status, bool has_custom_predicate = false);
+
+
+    size_t GetOperationCount() const;
+
+private:
+    // Must be called under the mutex
+    void WriteOperationHeader(WorkloadOperationType type);
+
+
+    void WriteUnsigned(uint64_t value);
+
+
+    void WriteSigned(int64_t value);
+
+
+    void WriteString(std::string_view text);
+
+
+    std::ostream& output_;
+    mutable std::mutex mutex_;
+    const std::chrono::steady_clock::time_point start_time_ = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds last_timestamp_{ 0 };
+    size_t operation_count_ = 0;
+};
+
+
+// Reads a log written by WorkloadRecorder; throws std::runtime_error if the log is corrupted
+class WorkloadReader {
+public:
+    explicit WorkloadReader(std::istream& input);
+
+
+    // Empty at the end of the log
+    std::optional<WorkloadOperation> ReadNext();
+
+private:
+    uint64_t ReadUnsigned();
+
+
+    int64_t ReadSigned();
+
+
+    std::string ReadString();
+
+
+    std::istream& input_;
+    std::chrono::nanoseconds last_timestamp_{ 0 };
+};
\ No newline at end of file